@@ -0,0 +1,164 @@
+/**
+ * @file
+ * @brief Teljesítményszámlálók implementáció.
+ */
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "counters.h"
+
+/// Egy esemény leírása a \c perf_event_open számára.
+struct EventSpec {
+	uint32_t type;
+	uint64_t config;
+	const char* name;
+};
+
+/// Gyorsítótár-esemény kódja (lásd \c perf_event_open(2)).
+static constexpr uint64_t cache_event(uint64_t cache) {
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static constexpr EventSpec EVENTS[Counters::EVENT_COUNT] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses"},
+	{PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_L1D), "L1-dcache-load-misses"},
+	{PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL), "LLC-load-misses"},
+};
+
+/// A számlálót kiolvasó-kalibráló ismétlések száma.
+static constexpr int CALIBRATION_ROUNDS = 64;
+
+Counters::Counters(void) {
+	for (int& s: slot) s = -1;
+	for (size_t e = 0; e < EVENT_COUNT; e++) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof attr);
+		attr.size = sizeof attr;
+		attr.type = EVENTS[e].type;
+		attr.config = EVENTS[e].config;
+		attr.read_format = PERF_FORMAT_GROUP;
+		// user space only, this is allowed with the default perf_event_paranoid
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+		if (fd < 0) {
+			// without cycles there is no group, the other events are optional
+			if (e == Cycles) {
+				unavailable = strerror(errno);
+				break;
+			}
+			continue;
+		}
+		if (leader < 0) leader = fd;
+		slot[e] = (int)fds.size();
+		fds.push_back(fd);
+	}
+
+	// the cost of a read, the minimum over a few back-to-back reads
+	for (uint64_t& v: overhead.values) v = UINT64_MAX;
+	overhead.ns = UINT64_MAX;
+	for (int i = 0; i < CALIBRATION_ROUNDS; i++) {
+		Sample a = read(), b = read();
+		for (size_t e = 0; e < EVENT_COUNT; e++)
+			overhead.values[e] = std::min(overhead.values[e], b.values[e] - a.values[e]);
+		overhead.ns = std::min(overhead.ns, b.ns - a.ns);
+	}
+
+	calls.push_back(symbols.intern("(top level)"));
+	rows.resize(symbols.size());
+	rows[calls.back()].calls = 1;
+	last = read();
+}
+
+Counters::~Counters(void) {
+	for (int fd: fds) close(fd);
+}
+
+Counters::Sample Counters::read(void) const {
+	Sample s;
+	if (leader >= 0) {
+		uint64_t buffer[1 + EVENT_COUNT];
+		if (::read(leader, buffer, sizeof buffer) > 0)
+			for (size_t e = 0; e < EVENT_COUNT; e++)
+				if (slot[e] >= 0 && (uint64_t)slot[e] < buffer[0]) s.values[e] = buffer[1 + slot[e]];
+	}
+	s.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return s;
+}
+
+void Counters::charge(void) {
+	Sample now = read();
+	Sample& total = rows[calls.back()].total;
+	for (size_t e = 0; e < EVENT_COUNT; e++) {
+		uint64_t d = now.values[e] - last.values[e];
+		total.values[e] += d > overhead.values[e] ? d - overhead.values[e] : 0;
+	}
+	uint64_t d = now.ns - last.ns;
+	total.ns += d > overhead.ns ? d - overhead.ns : 0;
+	last = now;
+}
+
+void Counters::enter(uint32_t symbol) {
+	charge();
+	if (symbol >= rows.size()) rows.resize(symbols.size());
+	rows[symbol].calls++;
+	calls.push_back(symbol);
+}
+
+void Counters::leave(void) {
+	charge();
+	calls.pop_back();
+}
+
+void Counters::report(std::ostream& out) {
+	charge();
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < rows.size(); i++)
+		if (rows[i].calls) order.push_back(i);
+	Event key = leader >= 0 ? Cycles : EVENT_COUNT;
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return key == Cycles ? rows[a].total.values[Cycles] > rows[b].total.values[Cycles] : rows[a].total.ns > rows[b].total.ns;
+	});
+
+	if (leader < 0)
+		out << "# hardware counters unavailable (" << unavailable << "), only calls and time are reported\n";
+	else
+		for (size_t e = 0; e < EVENT_COUNT; e++)
+			if (slot[e] < 0) out << "# " << EVENTS[e].name << " unavailable\n";
+	out << "# self cost of each word, without the words it calls; per call values are averages\n";
+	out << std::left << std::setw(20) << "# word" << std::right << std::setw(12) << "calls" << std::setw(12) << "ms"
+		<< std::setw(12) << "ns/call";
+	if (leader >= 0)
+		out << std::setw(14) << "cycles/call" << std::setw(8) << "IPC" << std::setw(14) << "br-miss/call"
+			<< std::setw(14) << "L1-miss/call" << std::setw(14) << "LLC-miss/call";
+	out << "\n" << std::fixed;
+
+	for (uint32_t i: order) {
+		Row const& r = rows[i];
+		double n = (double)r.calls;
+		out << std::left << std::setw(20) << symbols.name(i) << std::right << std::setw(12) << r.calls
+			<< std::setprecision(3) << std::setw(12) << r.total.ns / 1e6
+			<< std::setprecision(1) << std::setw(12) << r.total.ns / n;
+		if (leader >= 0) {
+			out << std::setw(14) << r.total.values[Cycles] / n;
+			if (slot[Instructions] >= 0 && r.total.values[Cycles])
+				out << std::setprecision(2) << std::setw(8) << (double)r.total.values[Instructions] / r.total.values[Cycles];
+			else
+				out << std::setw(8) << "-";
+			out << std::setprecision(3);
+			for (Event e: {BranchMisses, L1Misses, LLCMisses}) {
+				if (slot[e] >= 0) out << std::setw(14) << r.total.values[e] / n;
+				else out << std::setw(14) << "-";
+			}
+		}
+		out << "\n";
+	}
+}
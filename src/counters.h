@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Hardveres teljesítményszámlálók szavanként (\c --counters).
+ *
+ * A Linux \c perf_event_open interfészével méri a processzorciklusokat, az
+ * utasításokat, a rosszul jósolt ugrásokat és a gyorsítótár-hibákat, és minden
+ * szóhoz (beépítetthez és definiálthoz is) hozzárendeli a futása alatt mért
+ * értékeket. A szavak saját költségét méri: egy szó sorában nem szerepel az,
+ * amit az általa hívott szavak futtatása közben mért.
+ *
+ * Minden szó elején és végén kiolvassa a számlálókat, ami nagyságrendekkel
+ * lassabb egy egyszerű beépített szónál. A kiolvasás saját költségét induláskor
+ * megméri és levonja, de a nagyon rövid szavak értékei így is torzak lehetnek.
+ */
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "symbols.h"
+
+/// Szavankénti teljesítményszámlálók.
+class Counters {
+public:
+	/// A mért események.
+	enum Event {
+		Cycles,
+		Instructions,
+		BranchMisses,
+		L1Misses,
+		LLCMisses,
+		EVENT_COUNT
+	};
+
+	/// A mért szavak.
+	SymbolTable symbols;
+
+	/// A számlálók megnyitása a hívó szálra.
+	/**
+	 * Ha a számlálók nem érhetőek el (pl. konténerben, vagy a
+	 * \c perf_event_paranoid beállítás miatt), csak a hívások számát és az
+	 * eltelt időt méri.
+	 */
+	Counters(void);
+	~Counters(void);
+
+	Counters(Counters const&) = delete;
+	Counters& operator=(Counters const&) = delete;
+
+	/// Szó futtatásának kezdete: az eddig mért értékek a hívó szóhoz tartoznak.
+	/// @param symbol A szó azonosítója a \c symbols táblában.
+	void enter(uint32_t symbol);
+
+	/// Szó futtatásának vége: az enter() óta mért értékek (a hívott szavakéi nélkül) a szóhoz tartoznak.
+	void leave(void);
+
+	/// A szavankénti értékek kiírása, a legtöbb ciklust (időt) használóval kezdve.
+	void report(std::ostream& out);
+
+private:
+	/// A számlálók és az idő egy kiolvasása.
+	struct Sample {
+		uint64_t values[EVENT_COUNT] = {};
+		uint64_t ns = 0;
+	};
+
+	/// Egy szó összesített értékei.
+	struct Row {
+		uint64_t calls = 0;
+		Sample total;
+	};
+
+	/// A csoport vezető számlálójának leírója, vagy -1, ha nincs számláló.
+	int leader = -1;
+	std::vector<int> fds;
+	/// Az egyes események helye a csoport kiolvasásában, vagy -1, ha az esemény nem mérhető.
+	int slot[EVENT_COUNT];
+	/// Miért nem érhetőek el a számlálók.
+	std::string unavailable;
+
+	std::vector<Row> rows;
+	/// A futó szavak azonosítói, a legkülső a \c (top \c level).
+	std::vector<uint32_t> calls;
+	/// Az utolsó kiolvasás.
+	Sample last;
+	/// Egy kiolvasás saját költsége, ezt minden mérésből levonja.
+	Sample overhead;
+
+	Sample read(void) const;
+	/// A legutóbbi kiolvasás óta mért értékek hozzáadása a futó szóhoz.
+	void charge(void);
+};
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @brief Szótár és inliner implementáció.
+ */
+#include "dictionary.h"
+#include "interpreter.h"
+
+/// Blokk mérete, a beágyazott blokkok elemeivel együtt.
+static size_t block_size(Block const& code) {
+	size_t size = 0;
+	for (const Object* o: code) {
+		size++;
+		if (o->type() == Object::Block)
+			size += block_size(*(const Block*)o->get_value());
+	}
+	return size;
+}
+
+/// Hívja-e a blokk (vagy egy beágyazott blokkja) az adott szót.
+static bool calls(Block const& code, std::string const& name) {
+	for (const Object* o: code) {
+		if (o->type() == Object::Word && *(const std::string*)o->get_value() == name)
+			return true;
+		if (o->type() == Object::Block && calls(*(const Block*)o->get_value(), name))
+			return true;
+	}
+	return false;
+}
+
+/// Lehet-e definíció a blokk futása közben.
+/**
+ * Nem lehet, ha a blokk (és a beágyazott blokkjai) csak beépített szavakat
+ * hív, és azok közül a blokkot futtatók a közvetlenül előttük álló literál
+ * blokkokat kapják.
+ */
+static bool closed(Block const& code) {
+	for (size_t i = 0; i < code.size(); i++) {
+		const Object* o = code[i];
+		if (o->type() == Object::Block && !closed(*(const Block*)o->get_value()))
+			return false;
+		if (o->type() != Object::Word)
+			continue;
+		// definitions and calls of defined words are not builtins
+		std::string const& name = *(const std::string*)o->get_value();
+		if (!is_builtin(name))
+			return false;
+		size_t blocks = builtin_blocks(name);
+		if (blocks > i)
+			return false;
+		for (size_t j = i - blocks; j < i; j++)
+			if (code[j]->type() != Object::Block)
+				return false;
+	}
+	return true;
+}
+
+bool Dictionary::inline_block(Block const& code, Block& out, std::string const& self, Entry& entry) {
+	bool changed = false;
+	for (const Object* o: code) {
+		if (o->type() == Object::Word) {
+			std::string const& name = *(const std::string*)o->get_value();
+			auto it = name == self || is_builtin(name) ? words.end() : words.find(name);
+			if (it != words.end() && !it->second.recursive && it->second.size <= threshold) {
+				// the words remember the call they were copied from, for the error messages
+				auto direct = std::make_shared<const std::vector<std::string>>(1, name);
+				for (const Object* i: *(const Block*)it->second.compiled.get_value()) {
+					Object* copy = i->clone();
+					if (copy->type() == Object::Word) {
+						OTWord* w = (OTWord*)copy;
+						if (!w->inlined) {
+							w->inlined = direct;
+						} else {
+							std::vector<std::string> chain = *w->inlined;
+							chain.push_back(name);
+							w->inlined = std::make_shared<const std::vector<std::string>>(std::move(chain));
+						}
+					}
+					out.push_back(copy);
+				}
+				entry.inlined.insert(name);
+				changed = true;
+				continue;
+			}
+		} else if (o->type() == Object::Block) {
+			OTBlock* inner = new OTBlock();
+			inner->location = ((const OTBlock*)o)->location;
+			if (inline_block(*(const Block*)o->get_value(), *(Block*)inner->get_value(), self, entry)) {
+				out.push_back(inner);
+				changed = true;
+				continue;
+			}
+			delete inner;
+		}
+		out.push_back(o->clone());
+	}
+	return changed;
+}
+
+void Dictionary::link(std::string const& name) {
+	Entry& entry = words.at(name);
+	for (std::string const& w: entry.inlined)
+		dependents[w].erase(name);
+	entry.inlined.clear();
+
+	entry.compiled = entry.source;
+	if (threshold > 0) {
+		OTBlock compiled;
+		if (inline_block(*(const Block*)entry.source.get_value(), *(Block*)compiled.get_value(), name, entry)) {
+			// a redefinition made while the body runs would not reach the copied callees
+			if (closed(*(const Block*)compiled.get_value())) entry.compiled = compiled;
+			else entry.inlined.clear();
+		}
+	}
+	for (std::string const& w: entry.inlined)
+		dependents[w].insert(name);
+
+	Block const& body = *(const Block*)entry.compiled.get_value();
+	entry.size = block_size(body);
+	entry.recursive = calls(body, name);
+}
+
+void Dictionary::unlink_dependents(std::string const& name, std::vector<std::string>& stale) {
+	auto it = dependents.find(name);
+	if (it == dependents.end()) return;
+	std::unordered_set<std::string> users = std::move(it->second);
+	dependents.erase(it);
+
+	for (std::string const& user: users) {
+		Entry& entry = words.at(user);
+		// already reset through another word
+		if (entry.inlined.empty()) continue;
+		for (std::string const& w: entry.inlined)
+			if (w != name) dependents[w].erase(user);
+		entry.inlined.clear();
+		entry.compiled = entry.source;
+		entry.size = block_size(*(const Block*)entry.compiled.get_value());
+		entry.recursive = calls(*(const Block*)entry.compiled.get_value(), user);
+		stale.push_back(user);
+		unlink_dependents(user, stale);
+	}
+}
+
+void Dictionary::define(std::string const& name, Block const& body) {
+	// the words that copied the old body in must not use it in the new one
+	std::vector<std::string> stale;
+	unlink_dependents(name, stale);
+
+	revision_count++;
+	words[name].source = OTBlock(body);
+	link(name);
+	for (std::string const& w: stale)
+		link(w);
+}
+
+void Dictionary::freeze(void) const {
+	if (frozen_revision == revision_count) return;
+	frozen_revision = revision_count;
+	for (auto const& w: words) {
+		w.second.source.freeze();
+		w.second.compiled.freeze();
+	}
+}
@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Felhasználó által definiált szavak tárolása és beillesztése (inlining).
+ */
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "parser.h"
+
+/// Felhasználó által definiált szavak szótára.
+/**
+ * Minden szónak két törzse van: a definiált (forrás) és a lefordított, amit
+ * futtatunk. A lefordított törzsben a kicsi, nem rekurzív szavak hívásai
+ * helyén már a törzsük szerepel (a beágyazott blokkokban is, pl. \c map és
+ * \c if paramétereiben), így nem kell őket futás közben megkeresni.
+ *
+ * Ha egy beillesztett szót újradefiniálnak, az őt beillesztő szavakat újra
+ * lefordítja a forrásukból, így a viselkedés ugyanaz, mintha minden hívásnál
+ * megkeresnénk a szót. A már futó törzs viszont a régi marad, ezért csak olyan
+ * törzsbe illeszt be, amelynek futása közben nem lehet definíció: nem definiál
+ * szót, minden hívott definiált szót beilleszt, és csak a közvetlenül előtte
+ * álló literál blokkokat futtatja (lásd builtin_blocks()). A beillesztett
+ * szavak a hibaüzenetben is megmaradnak (lásd OTWord::inlined).
+ */
+class Dictionary {
+	/// Egy definiált szó.
+	struct Entry {
+		/// A definiált törzs.
+		OTBlock source;
+		/// A futtatott törzs, beillesztett szavakkal.
+		OTBlock compiled;
+		/// A lefordított törzsbe beillesztett szavak.
+		std::unordered_set<std::string> inlined;
+		/// A lefordított törzs mérete (a beágyazott blokkokkal együtt).
+		size_t size = 0;
+		/// Hívja-e a lefordított törzs a szót magát.
+		bool recursive = false;
+	};
+
+	std::unordered_map<std::string, Entry> words;
+	/// Szavanként azok a szavak, amelyekbe be lett illesztve.
+	std::unordered_map<std::string, std::unordered_set<std::string>> dependents;
+	size_t threshold;
+	/// A define() hívások száma.
+	size_t revision_count = 0;
+	/// A legutóbbi freeze() hívás revíziója, addig nem kell újra fagyasztani.
+	mutable size_t frozen_revision = SIZE_MAX;
+
+	/// Szó lefordítása a forrásából.
+	void link(std::string const& name);
+	/// A szót beillesztő szavak (tranzitívan) visszaállítása a forrásukra.
+	/// @param[out] stale A visszaállított szavak.
+	void unlink_dependents(std::string const& name, std::vector<std::string>& stale);
+	/// Blokk elemeinek bemásolása, a hívások helyére a beilleszthető szavak törzsét téve.
+	/// @returns Történt-e beillesztés.
+	bool inline_block(std::vector<Object*> const& code, std::vector<Object*>& out, std::string const& self, Entry& entry);
+public:
+	/// Alapértelmezett méretkorlát beillesztéshez.
+	static constexpr size_t DEFAULT_INLINE_THRESHOLD = 16;
+
+	/// @param inline_threshold Ennél nagyobb törzsű szavakat nem illeszt be. 0 esetén semmit.
+	explicit Dictionary(size_t inline_threshold = DEFAULT_INLINE_THRESHOLD): threshold(inline_threshold) {}
+
+	Dictionary(Dictionary const&) = default;
+	Dictionary& operator=(Dictionary const&) = default;
+
+	/// Szó (újra)definiálása.
+	/// @param name A szó neve.
+	/// @param body A szó törzse, lemásolja.
+	void define(std::string const& name, std::vector<Object*> const& body);
+
+	/// Szó futtatandó törzsének keresése.
+	/// @returns A lefordított törzs, vagy \c nullptr, ha nincs ilyen szó.
+	const OTBlock* find(std::string const& name) const {
+		auto it = words.find(name);
+		return it == words.end() ? nullptr : &it->second.compiled;
+	}
+
+	/// Változás számláló: minden definícióval nő, a másolat ugyanannyiról indul.
+	size_t revision(void) const { return revision_count; }
+
+	/// A törzsek előkészítése megosztásra, lásd Object::freeze().
+	/**
+	 * Ezután a szótár másolatait több szál is használhatja egyszerre, amíg
+	 * ezt a példányt senki nem módosítja. Ha a legutóbbi hívás óta nem volt
+	 * definíció, nem csinál semmit.
+	 */
+	void freeze(void) const;
+};
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file
+ * @brief Hash tábla implementáció.
+ */
+#include <cstring>
+#include <utility>
+#include <functional>
+
+#include "hashmap.h"
+
+/// A tábla kezdeti mérete (kettő hatványa kell legyen).
+static constexpr size_t INITIAL_CAPACITY = 16;
+
+/// Egész kulcs hash-e (splitmix64).
+static inline uint64_t hash_int(int64_t x) {
+	uint64_t z = (uint64_t)x + 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+/// Kulcs hash-e.
+/// @warning Nem ellenőrzi, hogy a kulcs megfelelő-e.
+static inline uint64_t hash_key(const Object* key) {
+	if (key->type() == Object::Int)
+		return hash_int(*(const int64_t*)key->get_value());
+	return std::hash<std::string_view>()(((const OTString*)key)->view());
+}
+
+
+/// Skalár-e az érték, azaz a táblában tároljuk-e közvetlenül.
+static inline bool is_scalar(Object::Type t) {
+	return t == Object::Int || t == Object::Float;
+}
+
+HashMap::HashMap(void): slots(INITIAL_CAPACITY), count(0) {}
+
+HashMap::HashMap(HashMap const& other): slots(other.slots), count(other.count), key_text(other.key_text) {
+	// the values that are not stored inline are owned, they have to be cloned
+	for (Slot& s: slots)
+		if (s.dist && !is_scalar(s.value_type))
+			s.val.o = s.val.o->clone();
+}
+
+std::string_view HashMap::text_key(Slot const& s) const {
+	size_t length;
+	memcpy(&length, key_text.data() + s.key.text, sizeof length);
+	return std::string_view(key_text.data() + s.key.text + sizeof length, length);
+}
+
+bool HashMap::same_key(Slot const& s, const Object* key) const {
+	if (s.key_type != key->type()) return false;
+	if (s.key_type == Object::Int) return s.key.i == *(const int64_t*)key->get_value();
+	return text_key(s) == ((const OTString*)key)->view();
+}
+
+bool HashMap::valid_key(const Object* key) {
+	return key->type() == Object::Int || key->type() == Object::String;
+}
+
+const HashMap::Slot* HashMap::find(const Object* key, uint64_t hash) const {
+	size_t mask = slots.size() - 1;
+	size_t idx = hash & mask;
+	for (uint32_t dist = 1; ; dist++, idx = (idx + 1) & mask) {
+		Slot const& s = slots[idx];
+		// an empty slot, or a key that is closer to its home than we would be: not found
+		if (s.dist < dist) return nullptr;
+		if (s.hash == hash && same_key(s, key))
+			return &s;
+	}
+}
+
+void HashMap::insert(Slot slot) {
+	size_t mask = slots.size() - 1;
+	size_t idx = slot.hash & mask;
+	slot.dist = 1;
+	for (;; idx = (idx + 1) & mask, slot.dist++) {
+		Slot& s = slots[idx];
+		if (!s.dist) {
+			s = slot;
+			return;
+		}
+		// take the place of a key closer to its home, and carry that one on
+		if (s.dist < slot.dist)
+			std::swap(s, slot);
+	}
+}
+
+void HashMap::grow(void) {
+	std::vector<Slot> old(slots.size() * 2);
+	std::swap(old, slots);
+	for (Slot const& s: old)
+		if (s.dist) insert(s);
+}
+
+void HashMap::release(Slot& slot) {
+	if (!is_scalar(slot.value_type)) delete slot.val.o;
+}
+
+void HashMap::put(const Object* key, Object* value) {
+	uint64_t hash = hash_key(key);
+	Slot* existing = const_cast<Slot*>(find(key, hash));
+
+	Slot slot;
+	Slot& target = existing ? *existing : slot;
+	if (existing) release(*existing);
+	target.value_type = value->type();
+	switch (value->type()) {
+		case Object::Int: 	target.val.i = *(int64_t*)value->get_value(); delete value; break;
+		case Object::Float:	target.val.f = *(double*)value->get_value(); delete value; break;
+		default:			target.val.o = value; break;
+	}
+	if (existing) return;
+
+	// keep the load factor under 80%
+	if ((count + 1) * 5 > slots.size() * 4) grow();
+	slot.hash = hash;
+	slot.key_type = key->type();
+	if (slot.key_type == Object::Int) {
+		slot.key.i = *(const int64_t*)key->get_value();
+	} else {
+		std::string_view text = ((const OTString*)key)->view();
+		size_t length = text.size();
+		slot.key.text = key_text.size();
+		key_text.resize(key_text.size() + sizeof length + length);
+		memcpy(key_text.data() + slot.key.text, &length, sizeof length);
+		memcpy(key_text.data() + slot.key.text + sizeof length, text.data(), length);
+	}
+	insert(slot);
+	count++;
+}
+
+Object* HashMap::get(const Object* key) const {
+	const Slot* s = find(key, hash_key(key));
+	return s ? value_object(*s) : nullptr;
+}
+
+bool HashMap::has(const Object* key) const {
+	return find(key, hash_key(key)) != nullptr;
+}
+
+std::vector<Object*> HashMap::keys(void) const {
+	std::vector<Object*> result;
+	result.reserve(count);
+	for (Slot const& s: slots)
+		if (s.dist) result.push_back(key_object(s));
+	return result;
+}
+
+void HashMap::freeze(void) const {
+	for (Slot const& s: slots)
+		if (s.dist && s.value_type != Object::Int && s.value_type != Object::Float)
+			s.val.o->freeze();
+}
+
+Object* HashMap::key_object(Slot const& s) const {
+	if (s.key_type == Object::Int) return new OTInt(s.key.i);
+	return new OTString(std::string(text_key(s)));
+}
+
+Object* HashMap::value_object(Slot const& s) {
+	switch (s.value_type) {
+		case Object::Int:	return new OTInt(s.val.i);
+		case Object::Float:	return new OTFloat(s.val.f);
+		default:			return s.val.o->clone();
+	}
+}
+
+HashMap::~HashMap(void) {
+	for (Slot& s: slots)
+		if (s.dist) release(s);
+}
@@ -0,0 +1,140 @@
+/**
+ * @file
+ * @brief Hash tábla (Object::Map) osztályok.
+ */
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <type_traits>
+
+#include "parser.h"
+
+/// Nyílt címzésű (Robin Hood) hash tábla.
+/**
+ * A kulcsok egészek vagy szövegek lehetnek, az értékek bármilyen objektumok.
+ * Az egész és valós értékek és kulcsok közvetlenül a táblában vannak (nem külön
+ * objektumként), a kulcsok hash-e is el van tárolva, így az átméretezés és
+ * az összehasonlítás nem számolja újra. A szöveg kulcsok egy közös pufferben
+ * vannak, a helyek csak a helyüket tárolják, így egy hely 32 bájt, és a
+ * helyek mozgatása (átméretezés, Robin Hood csere) csak másolás.
+ */
+class HashMap {
+	/// Egy hely a táblában.
+	struct Slot {
+		uint64_t hash = 0;
+		/// 0, ha üres a hely, különben a távolság a kulcs "saját" helyétől, plusz 1.
+		uint32_t dist = 0;
+		Object::Type key_type, value_type;
+		union {
+			int64_t i;
+			/// Szöveg kulcs helye a key_text -ben.
+			size_t text;
+		} key;
+		union {
+			int64_t i;
+			double f;
+			/// A tábla birtokolja.
+			Object* o;
+		} val;
+	};
+	// the slots are moved around by plain copies
+	static_assert(std::is_trivially_copyable<Slot>::value, "HashMap::Slot must stay trivially copyable");
+
+	std::vector<Slot> slots;
+	size_t count;
+	/// A szöveg kulcsok egymás után, mindegyik előtt a hossza (\c size_t). Kulcsot nem lehet törölni, így csak nő.
+	std::vector<char> key_text;
+
+	/// Szöveg kulcs a key_text -ből.
+	std::string_view text_key(Slot const& s) const;
+	/// Egyezik-e a tárolt kulcs a keresettel.
+	bool same_key(Slot const& s, const Object* key) const;
+
+	/// Kulcs keresése.
+	/// @returns A kulcs helye, vagy \c nullptr, ha nincs a táblában.
+	const Slot* find(const Object* key, uint64_t hash) const;
+	/// Új kulcs beszúrása (ellenőrzés nélkül), a Robin Hood szabály szerint.
+	void insert(Slot slot);
+	/// A tábla méretének megduplázása.
+	void grow(void);
+	/// Az érték törlése egy helyről.
+	static void release(Slot& slot);
+public:
+	HashMap(void);
+	HashMap(HashMap const& other);
+	HashMap& operator=(HashMap const&) = delete;
+
+	/// Használható-e kulcsként az objektum.
+	static bool valid_key(const Object* key);
+
+	/// Érték beállítása.
+	/**
+	 * @param key A kulcs, egész vagy szöveg.
+	 * @param value Az érték, amit ezután a tábla birtokol.
+	 * @warning Nem ellenőrzi, hogy a kulcs megfelelő-e, lásd valid_key().
+	 */
+	void put(const Object* key, Object* value);
+
+	/// Érték lekérdezése.
+	/// @returns Új objektum, amelyet a hívó birtokol, vagy \c nullptr, ha nincs ilyen kulcs.
+	Object* get(const Object* key) const;
+
+	/// Benne van-e a kulcs a táblában.
+	bool has(const Object* key) const;
+
+	/// A kulcsok, (a táblán belüli) sorrendben.
+	/// @returns Új objektumok, amelyeket a hívó birtokol.
+	std::vector<Object*> keys(void) const;
+
+	/// A párok száma.
+	size_t size(void) const { return count; }
+
+	/// Az értékként tárolt objektumok előkészítése megosztásra, lásd Object::freeze().
+	void freeze(void) const;
+
+	/// Párok bejárása.
+	/// @param f <tt>void(Object* key, Object* value)</tt>, a paramétereit f birtokolja.
+	template<typename F> void for_each(F f) const {
+		for (Slot const& s: slots)
+			if (s.dist) f(key_object(s), value_object(s));
+	}
+
+	~HashMap(void);
+private:
+	Object* key_object(Slot const& s) const;
+	static Object* value_object(Slot const& s);
+};
+
+/// Kulcs-érték párok gyűjteménye.
+/**
+ * A tábla megosztott, a másolás (pl. \c dup) nem másolja az elemeket. Saját
+ * táblát csak akkor készít (copy-on-write), ha módosítani akarják.
+ */
+class OTMap: public Object {
+	std::shared_ptr<HashMap> value;
+public:
+	OTMap(void): value(std::make_shared<HashMap>()) {}
+
+	Object::Type type(void) const override { return Object::Map; }
+
+	/// A tábla, módosításhoz (ha kell, előbb lemásolja).
+	void* get_value(void) override {
+		if (value.use_count() > 1) value = std::make_shared<HashMap>(*value);
+		return value.get();
+	}
+	const void* get_value(void) const override { return value.get(); }
+
+	OTMap* clone(void) const override { return new OTMap(*this); }
+
+	void freeze(void) const override { value->freeze(); }
+
+	/// A tábla, olvasáshoz.
+	HashMap const& table(void) const { return *value; }
+};
+
+#endif
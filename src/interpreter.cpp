@@ -2,8 +2,6 @@
  * @file 
  *
  *
- * @todo \c index és \c slice ? 
- * @todo \c sort helyett \c grade ?
  * @todo ezt bővíteni
  * @todo \c iota helyett \c [a..b], \c [0..b], \c [1..b] ?
  */
@@ -11,9 +9,24 @@
 #include <vector>
 #include <unordered_map>
 #include <iostream>
+#include <type_traits>
+#include <algorithm>
+#include <string_view>
+#include <cmath>
 
 #include "interpreter.h"
 #include "parser.h"
+#include "io.h"
+#include "sort.h"
+#include "hashmap.h"
+#include "operators.h"
+#include "text.h"
+#include "trace.h"
+#include "counters.h"
+#include "sampler.h"
+#include "tasks.h"
+#include "jit.h"
+#include "memory.h"
 
 /// Objektum értéke.
 /** 
@@ -41,6 +54,358 @@ static inline Object* pop(Stack& stack) {
 	return p;
 }
 
+static Error execute_block(Environment&, Block const&, size_t from = 0);
+static Error execute_block(Environment&, OTBlock const&);
+
+/// Sorozat-e az objektum.
+/** 
+ * Sorozat minden olyan objektum, aminek az elemein végig lehet menni (lista, 
+ * számtömb).
+ */
+static inline bool is_sequence(const Object* o) {
+	return o->type() == Object::List || o->type() == Object::Array;
+}
+
+/// Sorozat hossza.
+/// @warning A függvény nem ellenőrzi, hogy \c o sorozat-e!
+static inline size_t sequence_size(Object* o) {
+	if (o->type() == Object::Array) return ((OTArray*)o)->size();
+	return ((OTList*)o)->size();
+}
+
+/// Sorozat egy eleme.
+/// @warning A függvény nem ellenőrzi, hogy \c o sorozat-e, és az indexet sem!
+/// @returns Új objektum, amelyet a hívó birtokol.
+static inline Object* sequence_at(Object* o, size_t i) {
+	if (o->type() == Object::Array) return ((OTArray*)o)->at(i);
+	return ((OTList*)o)->at(i)->clone();
+}
+
+/// Sorozat vagy szöveg hossza.
+/// @warning A függvény nem ellenőrzi, hogy \c o sorozat vagy szöveg-e!
+static inline size_t sliceable_size(Object* o) {
+	if (o->type() == Object::String) return ((OTString*)o)->view().size();
+	return sequence_size(o);
+}
+
+/// Nézet egy sorozat vagy szöveg egy részére, az elemek másolása nélkül.
+/**
+ * @param o A lista, számtömb vagy szöveg.
+ * @param from Az első elem indexe.
+ * @param count Az elemek száma.
+ * @param step Két elem távolsága, szövegnél csak 1 lehet.
+ * @warning A függvény nem ellenőrzi a típust és a határokat!
+ * @returns Új objektum, amelyet a hívó birtokol.
+ */
+static Object* make_view(Object* o, size_t from, size_t count, size_t step = 1) {
+	switch (o->type()) {
+		case Object::Array:
+			return new OTArray(*(OTArray*)o, from, count, step);
+		case Object::String:
+			return new OTString(*(OTString*)o, from, count);
+		default:
+			return new OTList(*(OTList*)o, from, count, step);
+	}
+}
+
+/// Nézetet készítő szavak közös része.
+/**
+ * A verem tetején egy egész (\c n), alatta egy sorozat vagy szöveg (\c s) van, 
+ * ezeket lecseréli a \c make_range(n, size(s)) által megadott nézetre.
+ * @tparam F <tt>std::optional<std::pair<size_t, size_t>>(int64_t, size_t)</tt>, 
+ * 			 a nézet kezdete és hossza, vagy \c std::nullopt, ha \c n nem megfelelő.
+ */
+template<typename F> static Error view_word(Environment& env, F make_range) {
+	if (env.stack.size() < 2) return STACK_UNDERFLOW;
+	Object* n	= pop(env.stack);
+	Object* seq	= pop(env.stack);
+	if (n->type() != Object::Int || !(is_sequence(seq) || seq->type() == Object::String)) {
+		delete n; delete seq;
+		return TYPE_MISMATCH;
+	}
+	std::optional<std::pair<size_t, size_t>> range = make_range(value<int64_t>(n), sliceable_size(seq));
+	delete n;
+	if (!range) {
+		delete seq;
+		return INCORRECT_VALUE;
+	}
+	env.stack.push_back(make_view(seq, range->first, range->second));
+	delete seq;
+	return SUCCESS;
+}
+
+/// Átalakítható-e a lebegőpontos szám \c int64_t -vé (véges, és belefér).
+static bool fits_int64(double d) {
+	// 2^63 is exact as a double, the conversion of anything below it is defined
+	return std::isfinite(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0;
+}
+
+/// Számtömb kiírása bináris fájlba.
+/**
+ * Egész fájlba csak véges, az \c int64_t tartományába eső számok írhatók
+ * (különben \c INCORRECT_VALUE).
+ * @tparam T A kiírt elemek típusa (\c int64_t vagy \c double).
+ * @param seq A kiírandó lista vagy számtömb. Listában csak számok lehetnek.
+ * @param path A fájl elérési útja.
+ */
+template<typename T> static Error store_numbers(Object* seq, std::string const& path) {
+	constexpr bool to_int = std::is_same<T, int64_t>::value;
+	// check types and values before touching the file
+	if (seq->type() == Object::List) {
+		OTList* l = (OTList*)seq;
+		for (size_t i = 0; i < l->size(); i++) {
+			const Object* o = l->at(i);
+			if (o->type() != Object::Int && o->type() != Object::Float) return TYPE_MISMATCH;
+			if (to_int && o->type() == Object::Float && !fits_int64(*(const double*)o->get_value())) return INCORRECT_VALUE;
+		}
+	} else if (to_int && ((OTArray*)seq)->element_type() == Object::Float) {
+		OTArray* a = (OTArray*)seq;
+		for (size_t i = 0; i < a->size(); i++)
+			if (!fits_int64(a->float_at(i))) return INCORRECT_VALUE;
+	}
+
+	FileWriter w(path);
+	constexpr Object::Type wanted = to_int ? Object::Int : Object::Float;
+	if (seq->type() == Object::Array && ((OTArray*)seq)->element_type() == wanted && ((OTArray*)seq)->stride() == 1) {
+		// same representation, no conversion needed
+		OTArray* a = (OTArray*)seq;
+		w.write(a->get_value(), a->size() * sizeof(T));
+	} else if (seq->type() == Object::Array) {
+		OTArray* a = (OTArray*)seq;
+		for (size_t i = 0; i < a->size(); i++) {
+			T x = a->element_type() == Object::Int ? (T)a->int_at(i) : (T)a->float_at(i);
+			w.write(&x, sizeof(T));
+		}
+	} else {
+		OTList* l = (OTList*)seq;
+		for (size_t i = 0; i < l->size(); i++) {
+			const Object* o = l->at(i);
+			T x = o->type() == Object::Int ? *(const int64_t*)o->get_value() : *(const double*)o->get_value();
+			w.write(&x, sizeof(T));
+		}
+	}
+	return w.close() ? SUCCESS : IO_ERROR;
+}
+
+/// Bináris számfájl betöltése.
+/**
+ * @param env A futtatási környezet, a verem tetején a fájl elérési útjával.
+ * @param elem A tömb elemeinek típusa.
+ */
+static Error load_numbers(Environment& env, Object::Type elem) {
+	if (env.stack.size() < 1) return STACK_UNDERFLOW;
+	Object* path = pop(env.stack);
+	if (path->type() != Object::String) {
+		delete path;
+		return TYPE_MISMATCH;
+	}
+	std::shared_ptr<MappedBuffer> file = MappedBuffer::open(std::string(((OTString*)path)->view()));
+	delete path;
+	if (!file) return IO_ERROR;
+	if (file->size() % 8 != 0) return INCORRECT_VALUE;
+	env.stack.push_back(new OTArray(file, elem));
+	return SUCCESS;
+}
+
+/// Lista elemeinek közös típusa.
+/// @returns Az elemek típusa, ha mind ugyanolyan, üres lista esetén \c Object::Int,
+/// 		 különben \code{.cpp} std::nullopt \endcode.
+static std::optional<Object::Type> common_type(OTList const& list) {
+	if (list.size() == 0) return Object::Int;
+	Object::Type t = list.at(0)->type();
+	for (size_t i = 1; i < list.size(); i++)
+		if (list.at(i)->type() != t) return std::nullopt;
+	return t;
+}
+
+/// Természetes sorrend: számok érték szerint, utánuk a szövegek ábécésorrendben.
+/**
+ * @param[out] ok Hamisra állítja, ha az elemek nem összehasonlíthatóak.
+ */
+static bool natural_less(const Object* a, const Object* b, bool& ok) {
+	Object::Type at = a->type(), bt = b->type();
+	bool an = at == Object::Int || at == Object::Float;
+	bool bn = bt == Object::Int || bt == Object::Float;
+	if ((!an && at != Object::String) || (!bn && bt != Object::String)) {
+		ok = false;
+		return false;
+	}
+	if (an && bn) {
+		if (at == Object::Int && bt == Object::Int)
+			return *(const int64_t*)a->get_value() < *(const int64_t*)b->get_value();
+		double av = at == Object::Int ? (double)*(const int64_t*)a->get_value() : *(const double*)a->get_value();
+		double bv = bt == Object::Int ? (double)*(const int64_t*)b->get_value() : *(const double*)b->get_value();
+		return av < bv;
+	}
+	if (an != bn) return an;
+	return ((const OTString*)a)->view() < ((const OTString*)b)->view();
+}
+
+/// Sorozat rendező permutációja, számtömbként.
+/**
+ * Egész vagy valós elemekre radix sortot használ, különben a természetes 
+ * sorrend szerinti stabil rendezést.
+ * @param seq A rendezendő lista vagy számtömb.
+ * @param[out] perm A rendező permutáció.
+ */
+static Error grade_sequence(Object* seq, std::vector<int64_t>& perm) {
+	size_t n = sequence_size(seq);
+	perm.resize(n);
+	if (seq->type() == Object::Array) {
+		OTArray* a = (OTArray*)seq;
+		if (a->element_type() == Object::Int) {
+			if (a->stride() == 1) {
+				grade_ints(a->ints(), n, perm.data());
+			} else {
+				std::vector<int64_t> keys(n);
+				for (size_t i = 0; i < n; i++) keys[i] = a->int_at(i);
+				grade_ints(keys.data(), n, perm.data());
+			}
+		} else {
+			if (a->stride() == 1) {
+				grade_floats(a->floats(), n, perm.data());
+			} else {
+				std::vector<double> keys(n);
+				for (size_t i = 0; i < n; i++) keys[i] = a->float_at(i);
+				grade_floats(keys.data(), n, perm.data());
+			}
+		}
+		return SUCCESS;
+	}
+
+	OTList const& items = *(OTList*)seq;
+	std::optional<Object::Type> t = common_type(items);
+	if (t == Object::Int) {
+		std::vector<int64_t> keys(n);
+		for (size_t i = 0; i < n; i++) keys[i] = *(const int64_t*)items.at(i)->get_value();
+		grade_ints(keys.data(), n, perm.data());
+		return SUCCESS;
+	} else if (t == Object::Float) {
+		std::vector<double> keys(n);
+		for (size_t i = 0; i < n; i++) keys[i] = *(const double*)items.at(i)->get_value();
+		grade_floats(keys.data(), n, perm.data());
+		return SUCCESS;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < n; i++) perm[i] = (int64_t)i;
+	std::stable_sort(perm.begin(), perm.end(), [&](int64_t a, int64_t b) {
+		return ok && natural_less(items.at(a), items.at(b), ok);
+	});
+	return ok ? SUCCESS : TYPE_MISMATCH;
+}
+
+/// Sorozat rendező permutációja egy összehasonlító blokk szerint.
+/**
+ * @param env A futtatási környezet, a blokk ezen szavait látja.
+ * @param seq A rendezendő lista vagy számtömb.
+ * @param fn A blokk, ami két elemből (\c a \c b) kiszámolja, hogy \c a < \c b.
+ * @param[out] perm A rendező permutáció.
+ */
+static Error grade_sequence_by(Environment& env, Object* seq, OTBlock const& fn, std::vector<int64_t>& perm) {
+	size_t n = sequence_size(seq);
+	perm.resize(n);
+	for (size_t i = 0; i < n; i++) perm[i] = (int64_t)i;
+
+	Stack s;
+	Environment tmp_env = env.with_stack(s);
+	Error e = SUCCESS;
+	std::stable_sort(perm.begin(), perm.end(), [&](int64_t a, int64_t b) {
+		if (e != SUCCESS) return false;
+		s.push_back(sequence_at(seq, a));
+		s.push_back(sequence_at(seq, b));
+		e = execute_block(tmp_env, fn);
+		if (e == SUCCESS && s.empty()) e = STACK_UNDERFLOW;
+		if (e == SUCCESS && s.back()->type() != Object::Int) e = TYPE_MISMATCH;
+		bool result = e == SUCCESS && value<int64_t>(s.back()) != 0;
+		for (Object* o: s) delete o;
+		s.clear();
+		return result;
+	});
+	return e;
+}
+
+/// Sorozat átrendezése egy permutáció szerint.
+/**
+ * Listánál az elemeket nem másolja, csak a sorrendjüket változtatja meg.
+ * @param seq Az átrendezendő lista vagy számtömb, a hívó birtokolja.
+ * @returns Az átrendezett sorozat, új objektum.
+ */
+static Object* permute_sequence(Object* seq, std::vector<int64_t> const& perm) {
+	if (seq->type() == Object::Array) {
+		OTArray* a = (OTArray*)seq;
+		if (a->element_type() == Object::Int) {
+			std::vector<int64_t> v(perm.size());
+			for (size_t i = 0; i < perm.size(); i++) v[i] = a->int_at(perm[i]);
+			return new OTArray(std::make_shared<OwnedBuffer<int64_t>>(std::move(v)), Object::Int);
+		}
+		std::vector<double> v(perm.size());
+		for (size_t i = 0; i < perm.size(); i++) v[i] = a->float_at(perm[i]);
+		return new OTArray(std::make_shared<OwnedBuffer<double>>(std::move(v)), Object::Float);
+	}
+
+	// move the items over instead of cloning them (unless they are shared)
+	OTList* result = new OTList();
+	std::vector<Object*>& items = value<std::vector<Object*>>(seq);
+	std::vector<Object*>& out = value<std::vector<Object*>>(result);
+	out.reserve(perm.size());
+	for (int64_t i: perm) out.push_back(items[i]);
+	items.clear();
+	return result;
+}
+
+/// Rendező szavak közös része.
+/**
+ * @param env A futtatási környezet.
+ * @param by Van-e összehasonlító blokk a verem tetején.
+ * @param grade A permutációt adja-e vissza (vagy a rendezett sorozatot).
+ */
+static Error sort_word(Environment& env, bool by, bool grade) {
+	if (env.stack.size() < (by ? 2u : 1u)) return STACK_UNDERFLOW;
+	Object* fn = by ? pop(env.stack) : nullptr;
+	Object* seq = pop(env.stack);
+	if (!is_sequence(seq) || (fn && fn->type() != Object::Block)) {
+		delete fn; delete seq;
+		return TYPE_MISMATCH;
+	}
+
+	// plain ascending sort of numbers is a single radix sort
+	if (!by && !grade && seq->type() == Object::Array) {
+		OTArray* a = (OTArray*)seq;
+		Object* result;
+		if (a->element_type() == Object::Int) {
+			std::vector<int64_t> v(a->size());
+			for (size_t i = 0; i < v.size(); i++) v[i] = a->int_at(i);
+			sort_ints(v.data(), v.size());
+			result = new OTArray(std::make_shared<OwnedBuffer<int64_t>>(std::move(v)), Object::Int);
+		} else {
+			std::vector<double> v(a->size());
+			for (size_t i = 0; i < v.size(); i++) v[i] = a->float_at(i);
+			sort_floats(v.data(), v.size());
+			result = new OTArray(std::make_shared<OwnedBuffer<double>>(std::move(v)), Object::Float);
+		}
+		delete seq;
+		env.stack.push_back(result);
+		return SUCCESS;
+	}
+
+	std::vector<int64_t> perm;
+	Error e = by ? grade_sequence_by(env, seq, *(OTBlock*)fn, perm) 
+				 : grade_sequence(seq, perm);
+	delete fn;
+	if (e != SUCCESS) {
+		delete seq;
+		return e;
+	}
+
+	if (grade)
+		env.stack.push_back(new OTArray(std::make_shared<OwnedBuffer<int64_t>>(std::move(perm)), Object::Int));
+	else
+		env.stack.push_back(permute_sequence(seq, perm));
+	delete seq;
+	return SUCCESS;
+}
+
 /** @def WORD_HEADER
  *  @brief Beépített szavak függvényfejléce.
  */
@@ -51,33 +416,139 @@ static inline Object* pop(Stack& stack) {
  */
 #define UNUSED(arg) (void)((arg));
 
-static Error execute_block(Environment&, Block const&);
+/// Fájl sorai lusta sorozatként.
+class LineSource: public Source {
+	std::unique_ptr<LineReader> reader;
+public:
+	LineSource(std::unique_ptr<LineReader> r): reader(std::move(r)) {}
+
+	Error next(Object*& out) override {
+		std::string_view line;
+		if (reader->next(line)) {
+			out = new OTString(std::string(line));
+			return SUCCESS;
+		}
+		out = nullptr;
+		return reader->failed() ? IO_ERROR : SUCCESS;
+	}
+};
+
+/// Lusta sorozat elemeinek transzformációja (lusta \c map).
+class MapSource: public Source {
+	std::shared_ptr<Source> parent;
+	OTBlock fn;
+	/// A blokk saját verme, elemenként kiürül.
+	Stack s;
+	Environment tmp_env;
+public:
+	/// @param p A transzformálandó sorozat forrása.
+	/// @param f Az elemekre alkalmazott blokk.
+	/// @param env A környezet, amelynek a szavait (kimenetét, határidejét) a blokk látja.
+	MapSource(std::shared_ptr<Source> p, OTBlock const& f, Environment const& env)
+		: parent(std::move(p)), fn(f), tmp_env(env.with_stack(s)) {}
+
+	Error next(Object*& out) override {
+		out = nullptr;
+		Object* item;
+		Error e = parent->next(item);
+		if (e != SUCCESS || !item) return e;
+
+		s.push_back(item);
+		e = execute_block(tmp_env, fn);
+		if (e == SUCCESS && s.empty())
+			e = STACK_UNDERFLOW;
+		if (e == SUCCESS)
+			out = pop(s);
+		for (Object* o: s)
+			delete o;
+		s.clear();
+		return e;
+	}
+};
+
+/// Átadható-e az objektum egy másik feladatnak.
+/**
+ * A lusta sorozatok nem: a forrásuk a létrehozó feladat szavait és vermét
+ * is használhatja (lásd MapSource).
+ */
+static inline bool is_transferable(const Object* o) {
+	return o->type() != Object::Stream;
+}
+
+/// Blokk futtatása egy új feladatban.
+/**
+ * A feladat a saját vermén fut, a szavak egy másolatával, a hívó kimenetére
+ * írva és a hívó határidejéig. A blokkot és a szavak törzseit nem másolja le,
+ * hanem fagyasztja (lásd Object::freeze()), így mindkét szál használhatja őket.
+ * @param env A hívó környezete.
+ * @param body A futtatandó blokk, ezután a feladat birtokolja.
+ * @param args A feladat vermének kezdeti tartalma, ezután a feladat birtokolja.
+ * @returns A feladat, vagy üres, ha nem sikerült elindítani (ekkor \c body és \c args törlődik).
+ */
+static std::shared_ptr<Task> spawn_task(Environment& env, Object* body, Stack args) {
+	env.defined_words.freeze();
+	body->freeze();
+	for (Object* o: args) o->freeze();
+
+	auto task = std::make_shared<Task>();
+	auto words = std::make_shared<Dictionary>(env.defined_words);
+	std::shared_ptr<Object> code(body);
+	std::ostream& out = env.out;
+	Deadline deadline = env.deadline;
+	bool jit = env.jit != nullptr;
+	Error e = start_task([task, words, code, args, &out, deadline, jit]() {
+		Stack s = args;
+		// the compiled code is per thread
+		std::unique_ptr<Jit> task_jit = jit ? std::make_unique<Jit>() : nullptr;
+		Environment task_env{s, *words, out, deadline, nullptr, task_jit.get()};
+		Error e = execute_block(task_env, *(OTBlock*)code.get());
+		task->finish(e, std::move(s));
+	});
+	if (e != SUCCESS) {
+		for (Object* o: args) delete o;
+		return nullptr;
+	}
+	return task;
+}
+
+/// Az \c S. legfeljebb ennyi elemet ír ki a veremből, és ennyit minden listából.
+static constexpr size_t DEBUG_PRINT_LIMIT = 16;
+
+/// Beépített szó.
+struct Builtin {
+	/// A szó neve.
+	std::string_view name;
+	/// A szót futtató függvény.
+	Word fn;
+};
 
-/// @var static const std::unordered_map<std::string, Word> builtin_words
+/// @var static constexpr Builtin builtin_words[]
+/// @brief A beépített szavak. Újat felvenni csak ide kell (ha blokkot futtat, a block_words -be is), a keresőtábla fordításkor készül el.
 /// @todo Implement all built-ins.
-static const std::unordered_map<std::string, Word> builtin_words = {
+static constexpr Builtin builtin_words[] = {
 // STANDARD I/O	
 	// drop-printing
 	{".", WORD_HEADER {
 		if (env.stack.size() < 1) return STACK_UNDERFLOW;
 		Object* o = pop(env.stack);
-		std::cout << *o;
+		env.out << *o;
 		delete o;
 		return SUCCESS;
 	}},
 
-	// debug printing
+	// debug printing, only the top of a deep stack and the first items of long lists
 	{"S.", WORD_HEADER {
-		std::cout << "\n<" << env.stack.size() << ">\n";
-		for (auto o: env.stack)
-			std::cout << *o << "\n";
+		env.out << "\n<" << env.stack.size() << ">\n";
+		size_t from = env.stack.size() > DEBUG_PRINT_LIMIT ? env.stack.size() - DEBUG_PRINT_LIMIT : 0;
+		if (from) env.out << "... (" << from << " more)\n";
+		for (size_t i = from; i < env.stack.size(); i++)
+			print_object(env.out, *env.stack[i], DEBUG_PRINT_LIMIT) << "\n";
 		return SUCCESS;
 	}},
 
 	// insert newline into stdout
 	{"cr", WORD_HEADER {
-		UNUSED(env)
-		std::cout << "\n";
+		env.out << "\n";
 		return SUCCESS;
 	}},
 
@@ -120,126 +591,34 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 		}
 	}},
 	
+	// arithmetic on numbers, an int and a float operand give a float
 	// +: addition and string concatenation
-	{"+", WORD_HEADER {
-		if (env.stack.size() < 2) return STACK_UNDERFLOW;
-		Object* top		= pop(env.stack); Object::Type tt = top->type();
-		Object* bottom	= pop(env.stack); Object::Type bt = bottom->type();
-		switch (tt << 8 | bt) {
-			// Int, Int
-			case 0x00: {
-				int64_t tv = value<int64_t>(top);
-				int64_t bv = value<int64_t>(bottom);
-				env.stack.push_back(new OTInt( bv + tv ));
-			} break;
-			// Int, Float
-			case 0x01: { 
-				double tv = (double)value<int64_t>(top);
-				double bv = value<double>(bottom);
-				env.stack.push_back(new OTFloat( bv + tv ));
-			} break;
-			// Float, Int
-			case 0x10: {
-				double tv = value<double>(top);
-				double bv = (double)value<int64_t>(bottom);
-				env.stack.push_back(new OTFloat( bv + tv ));
-			} break;
-			// Float, Float
-			case 0x11: {
-				double tv = value<double>(top);
-				double bv = value<double>(bottom);
-				env.stack.push_back(new OTFloat( bv + tv ));
-			} break;
-			// String, String
-			case 0x33: {
-				std::string const& tv = value<std::string>(top);
-				std::string const& bv = value<std::string>(bottom);
-				env.stack.push_back(new OTString( bv + tv ));
-			} break; 
-			default:
-				delete top; delete bottom;
-				return TYPE_MISMATCH;
-		}
-		delete top; delete bottom;
-		return SUCCESS;
-	}},
-	
-	// *: multiplication
-	{"*", WORD_HEADER {
-		if (env.stack.size() < 2) return STACK_UNDERFLOW;
-		Object* top		= pop(env.stack); Object::Type tt = top->type();
-		Object* bottom	= pop(env.stack); Object::Type bt = bottom->type();
-		switch (tt << 8 | bt) {
-			// Int, Int
-			case 0x00: {
-				int64_t tv = value<int64_t>(top);
-				int64_t bv = value<int64_t>(bottom);
-				env.stack.push_back(new OTInt( bv * tv ));
-			} break;
-			// Int, Float
-			case 0x01: { 
-				double tv = (double)value<int64_t>(top);
-				double bv = value<double>(bottom);
-				env.stack.push_back(new OTFloat( bv * tv ));
-			} break;
-			// Float, Int
-			case 0x10: {
-				double tv = value<double>(top);
-				double bv = (double)value<int64_t>(bottom);
-				env.stack.push_back(new OTFloat( bv * tv ));
-			} break;
-			// Float, Float
-			case 0x11: {
-				double tv = value<double>(top);
-				double bv = value<double>(bottom);
-				env.stack.push_back(new OTFloat( bv * tv ));
-			} break;
-			default:
-				delete top; delete bottom;
-				return TYPE_MISMATCH;
-		}
-		delete top; delete bottom;
-		return SUCCESS;
-	}},
+	{"+", binary_word<Add>},
+	{"-", binary_word<Sub>},
+	{"*", binary_word<Mul>},
+	// /: integer division truncates, division by zero is an error for ints
+	{"/", binary_word<Div>},
+	{"%", binary_word<Mod>},
+	// min and max also work on strings
+	{"min", binary_word<Min>},
+	{"max", binary_word<Max>},
 
 // COMPARISONS
-	// <: strictly less-than
-	// TODO: consider supporting strings
-	{"<", WORD_HEADER {
-		if (env.stack.size() < 2) return STACK_UNDERFLOW;
-		Object* top		= pop(env.stack); Object::Type tt = top->type();
-		Object* bottom	= pop(env.stack); Object::Type bt = bottom->type();
-		switch (tt << 8 | bt) {
-			// Int, Int
-			case 0x00: {
-				int64_t tv = value<int64_t>(top);
-				int64_t bv = value<int64_t>(bottom);
-				env.stack.push_back(new OTInt( (int64_t)(bv < tv) ));
-			} break;
-			// Int, Float
-			case 0x01: { 
-				double tv = (double)value<int64_t>(top);
-				double bv = value<double>(bottom);
-				env.stack.push_back(new OTInt( (int64_t)(bv < tv) ));
-			} break;
-			// Float, Int
-			case 0x10: {
-				double tv = value<double>(top);
-				double bv = (double)value<int64_t>(bottom);
-				env.stack.push_back(new OTInt( (int64_t)(bv < tv) ));
-			} break;
-			// Float, Float
-			case 0x11: {
-				double tv = value<double>(top);
-				double bv = value<double>(bottom);
-				env.stack.push_back(new OTInt( (int64_t)(bv < tv) ));
-			} break;
-			default:
-				return TYPE_MISMATCH;
-		}
-		delete top; delete bottom;
-		return SUCCESS;
-	}},
+	// numbers with numbers, strings with strings; the result is 1 or 0
+	{"<", binary_word<Less>},
+	{">", binary_word<Greater>},
+	{"<=", binary_word<LessEqual>},
+	{">=", binary_word<GreaterEqual>},
+	{"=", binary_word<Equal>},
+	{"!=", binary_word<NotEqual>},
+
+// BITWISE OPERATIONS
+	// on ints only; shifting by less than 0 or more than 63 is an error
+	{"and", binary_word<BitAnd>},
+	{"or", binary_word<BitOr>},
+	{"xor", binary_word<BitXor>},
+	{"lshift", binary_word<ShiftLeft>},
+	{"rshift", binary_word<ShiftRight>},
 
 // LIST OPERATIONS
 	// iota: index generator, create a list from 0 to n-1
@@ -250,12 +629,14 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 		Object* top = pop(env.stack);
 		if (top->type() == Object::Int) {
 			int64_t end = value<int64_t>(top);
+			delete top;
 			if (end < 0) return INCORRECT_VALUE;
+			// the whole list is allocated here, so it is checked against the memory limit up front
+			if ((uint64_t)end > memory_left() / (sizeof(OTInt) + sizeof(Object*))) return OUT_OF_MEMORY;
 			env.stack.push_back(new OTList());
 			std::vector<Object*>& list_val = value<std::vector<Object*>>(env.stack.back());
 			for (int64_t i = 0; i < end; i++)
 				list_val.push_back(new OTInt(i));
-			delete top;
 			return SUCCESS;
 		}
 		delete top;
@@ -263,34 +644,54 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 	}},
 
 	// map: transform list by applying function
-	/// @bug Memóriahibás (valószínűleg ez a függvény)
 	{"map", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
 		Object* fn = pop(env.stack);
-		Object* list = env.stack.back(); // simpler to modify in-place
-		if (fn->type() == Object::Block && list->type() == Object::List) {
-			std::vector<Object*> const& fn_body = value<std::vector<Object*>>(fn);
-			std::vector<Object*>& items = value<std::vector<Object*>>(list);
-			Stack s; std::unordered_map<std::string, Block> w;
-			Environment tmp_env{s, w};
-			for (size_t idx = 0; idx < items.size(); idx++) {
-				for (auto i: tmp_env.stack)
-					delete i;
-				auto item = items.at(idx);
-				tmp_env.stack.push_back(item);
-				Error e = execute_block(tmp_env, fn_body);
-				if (e != SUCCESS) {
-					delete fn; delete list;
-					for (auto i: tmp_env.stack)
-						delete i;
-					return e;
-				}
-				delete item;
-				item = tmp_env.stack.back()->clone();
+		Object* list = pop(env.stack);
 
-			}
+		// streams are transformed lazily, when their items are requested
+		if (fn->type() == Object::Block && list->type() == Object::Stream) {
+			env.stack.push_back(new OTStream(std::make_shared<MapSource>(
+				((OTStream*)list)->source(), *(OTBlock*)fn, env
+			)));
+			delete fn; delete list;
+			return SUCCESS;
 		}
-		delete fn;
-		return TYPE_MISMATCH;
+
+		if (fn->type() != Object::Block || !is_sequence(list)) {
+			delete fn; delete list;
+			return TYPE_MISMATCH;
+		}
+
+		OTBlock const& fn_body = *(OTBlock*)fn;
+		size_t size = sequence_size(list);
+		OTList* result = new OTList();
+		std::vector<Object*>& items = value<std::vector<Object*>>(result);
+		items.reserve(size);
+
+		// every item is transformed on its own stack
+		Stack s;
+		Environment tmp_env = env.with_stack(s);
+		Error e = SUCCESS;
+		for (size_t idx = 0; idx < size && e == SUCCESS; idx++) {
+			tmp_env.stack.push_back(sequence_at(list, idx));
+			e = execute_block(tmp_env, fn_body);
+			if (e == SUCCESS && tmp_env.stack.empty())
+				e = STACK_UNDERFLOW;
+			if (e == SUCCESS)
+				items.push_back(pop(tmp_env.stack));
+			for (auto i: tmp_env.stack)
+				delete i;
+			tmp_env.stack.clear();
+		}
+
+		delete fn; delete list;
+		if (e != SUCCESS) {
+			delete result;
+			return e;
+		}
+		env.stack.push_back(result);
+		return SUCCESS;
 	}},
 
 	// reduce1: apply function between each element, using the first element as initial value
@@ -298,21 +699,37 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 		if (env.stack.size() < 2) return STACK_UNDERFLOW;
 		Object* fn = pop(env.stack);
 		Object* list = pop(env.stack);
-		if (fn->type() == Object::Block && list->type() == Object::List) {
-			std::vector<Object*> const& fn_body = value<std::vector<Object*>>(fn);
-			std::vector<Object*> const& val = value<std::vector<Object*>>(list);
+
+		// streams are consumed item by item
+		if (fn->type() == Object::Block && list->type() == Object::Stream) {
+			OTBlock const& fn_body = *(OTBlock*)fn;
+			Source& source = *((OTStream*)list)->source();
+			Object* item;
+			Error e = source.next(item);
+			if (e == SUCCESS && item) {
+				env.stack.push_back(item);
+				while ((e = source.next(item)) == SUCCESS && item) {
+					env.stack.push_back(item);
+					if ((e = execute_block(env, fn_body)) != SUCCESS)
+						break;
+				}
+			}
+			delete fn; delete list;
+			return e;
+		}
+
+		if (fn->type() == Object::Block && is_sequence(list)) {
+			OTBlock const& fn_body = *(OTBlock*)fn;
+			size_t size = sequence_size(list);
 			
-			if (val.size() == 0) {
+			if (size == 0) {
 				delete fn; delete list;
 				return SUCCESS;
-			} else if (val.size() == 1) {
-				env.stack.push_back(val.at(0)->clone());
-				delete fn; delete list;
 			}
 
-			env.stack.push_back(val.at(0)->clone());
-			for (auto it = val.cbegin() + 1; it != val.cend(); ++it) {
-				env.stack.push_back((*it)->clone());
+			env.stack.push_back(sequence_at(list, 0));
+			for (size_t idx = 1; idx < size; idx++) {
+				env.stack.push_back(sequence_at(list, idx));
 				Error e = execute_block(env, fn_body);
 				if (e != SUCCESS) {
 					delete fn; delete list;
@@ -327,7 +744,462 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 		return TYPE_MISMATCH;
 
 	}},
+
+	// collect: read all the items of a stream into a list
+	{"collect", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* stream = pop(env.stack);
+		if (stream->type() != Object::Stream) {
+			delete stream;
+			return TYPE_MISMATCH;
+		}
+		OTList* result = new OTList();
+		std::vector<Object*>& items = value<std::vector<Object*>>(result);
+		Source& source = *((OTStream*)stream)->source();
+		Object* item;
+		Error e;
+		while ((e = source.next(item)) == SUCCESS && item) {
+			items.push_back(item);
+			if (memory_exceeded()) {
+				e = OUT_OF_MEMORY;
+				break;
+			}
+		}
+		delete stream;
+		if (e != SUCCESS) {
+			delete result;
+			return e;
+		}
+		env.stack.push_back(result);
+		return SUCCESS;
+	}},
+
+// FILE OPERATIONS
+	// lines: lazily read the lines of a file
+	{"lines", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* path = pop(env.stack);
+		if (path->type() != Object::String) {
+			delete path;
+			return TYPE_MISMATCH;
+		}
+		std::unique_ptr<LineReader> reader = LineReader::open(std::string(((OTString*)path)->view()));
+		delete path;
+		if (!reader) return IO_ERROR;
+		env.stack.push_back(new OTStream(std::make_shared<LineSource>(std::move(reader))));
+		return SUCCESS;
+	}},
+
+	// stdin-lines: lazily read the lines of the standard input
+	{"stdin-lines", WORD_HEADER {
+		env.stack.push_back(new OTStream(std::make_shared<LineSource>(std::make_unique<LineReader>(0, false))));
+		return SUCCESS;
+	}},
+
+	// load-ints: map a binary file of native 64-bit integers as an array
+	{"load-ints", WORD_HEADER {
+		return load_numbers(env, Object::Int);
+	}},
+
+	// load-floats: map a binary file of native doubles as an array
+	{"load-floats", WORD_HEADER {
+		return load_numbers(env, Object::Float);
+	}},
+
+	// load-csv: read a numeric column (0-based) of a CSV file as an array
+	{"load-csv", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* column	= pop(env.stack);
+		Object* path	= pop(env.stack);
+		if (column->type() != Object::Int || path->type() != Object::String) {
+			delete column; delete path;
+			return TYPE_MISMATCH;
+		}
+		int64_t col = value<int64_t>(column);
+		std::shared_ptr<MappedBuffer> file = MappedBuffer::open(std::string(((OTString*)path)->view()));
+		delete column; delete path;
+		if (col < 0) return INCORRECT_VALUE;
+		if (!file) return IO_ERROR;
+
+		std::optional<OTArray> result = read_csv_column(*file, (size_t)col);
+		if (!result) return INCORRECT_VALUE;
+		env.stack.push_back(result->clone());
+		return SUCCESS;
+	}},
+
+	// store-ints: write a list of numbers to a binary file of 64-bit integers
+	// (floats are truncated; NaN, infinity or a value outside the int64 range is an error)
+	{"store-ints", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* path	= pop(env.stack);
+		Object* list	= pop(env.stack);
+		Error e = (path->type() == Object::String && is_sequence(list)) 
+			? store_numbers<int64_t>(list, std::string(((OTString*)path)->view()))
+			: TYPE_MISMATCH;
+		delete path; delete list;
+		return e;
+	}},
+
+	// store-floats: write a list of numbers to a binary file of doubles
+	{"store-floats", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* path	= pop(env.stack);
+		Object* list	= pop(env.stack);
+		Error e = (path->type() == Object::String && is_sequence(list)) 
+			? store_numbers<double>(list, std::string(((OTString*)path)->view()))
+			: TYPE_MISMATCH;
+		delete path; delete list;
+		return e;
+	}},
+
+	// sort: sort a list in ascending order (numbers first, then strings)
+	{"sort", WORD_HEADER {
+		return sort_word(env, false, false);
+	}},
+
+	// grade: the indices that would sort the list, as an array
+	{"grade", WORD_HEADER {
+		return sort_word(env, false, true);
+	}},
+
+	// sort-by: stable sort using a comparator block (`a b -- a<b`)
+	{"sort-by", WORD_HEADER {
+		return sort_word(env, true, false);
+	}},
+
+	// grade-by: sorting indices using a comparator block (`a b -- a<b`)
+	{"grade-by", WORD_HEADER {
+		return sort_word(env, true, true);
+	}},
+
+	// index: the item at a given index (negative counts from the end)
+	{"index", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* n	= pop(env.stack);
+		Object* seq	= pop(env.stack);
+		if (n->type() != Object::Int || !(is_sequence(seq) || seq->type() == Object::String)) {
+			delete n; delete seq;
+			return TYPE_MISMATCH;
+		}
+		int64_t idx = value<int64_t>(n);
+		int64_t size = (int64_t)sliceable_size(seq);
+		if (idx < 0) idx += size;
+		delete n;
+		if (idx < 0 || idx >= size) {
+			delete seq;
+			return INCORRECT_VALUE;
+		}
+		env.stack.push_back(seq->type() == Object::String ? make_view(seq, idx, 1) : sequence_at(seq, idx));
+		delete seq;
+		return SUCCESS;
+	}},
+
+	// slice: `s from count slice`, a view of `count` items starting at `from`
+	{"slice", WORD_HEADER {
+		if (env.stack.size() < 3) return STACK_UNDERFLOW;
+		Object* count = pop(env.stack);
+		if (count->type() != Object::Int) {
+			delete count;
+			return TYPE_MISMATCH;
+		}
+		int64_t c = value<int64_t>(count);
+		delete count;
+		return view_word(env, [c](int64_t from, size_t size) -> std::optional<std::pair<size_t, size_t>> {
+			if (from < 0 || c < 0 || (uint64_t)from > size || (uint64_t)c > size - from) return std::nullopt;
+			return std::make_pair((size_t)from, (size_t)c);
+		});
+	}},
+
+	// take: the first n items (the last -n, if negative)
+	{"take", WORD_HEADER {
+		return view_word(env, [](int64_t n, size_t size) -> std::optional<std::pair<size_t, size_t>> {
+			size_t count = std::min<uint64_t>(n < 0 ? -(uint64_t)n : n, size);
+			return std::make_pair(n < 0 ? size - count : 0, count);
+		});
+	}},
+
+	// drop-n: all but the first n items (the last -n, if negative)
+	{"drop-n", WORD_HEADER {
+		return view_word(env, [](int64_t n, size_t size) -> std::optional<std::pair<size_t, size_t>> {
+			size_t count = std::min<uint64_t>(n < 0 ? -(uint64_t)n : n, size);
+			return std::make_pair(n < 0 ? 0 : count, size - count);
+		});
+	}},
+
+	// stride: every n-th item of a list, starting with the first
+	{"stride", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* n	= pop(env.stack);
+		Object* seq	= pop(env.stack);
+		if (n->type() != Object::Int || !is_sequence(seq)) {
+			delete n; delete seq;
+			return TYPE_MISMATCH;
+		}
+		int64_t step = value<int64_t>(n);
+		delete n;
+		if (step < 1) {
+			delete seq;
+			return INCORRECT_VALUE;
+		}
+		size_t size = sequence_size(seq);
+		env.stack.push_back(make_view(seq, 0, (size + step - 1) / step, step));
+		delete seq;
+		return SUCCESS;
+	}},
+
+// MAP OPERATIONS
+	// map-new: create an empty map
+	{"map-new", WORD_HEADER {
+		env.stack.push_back(new OTMap());
+		return SUCCESS;
+	}},
+
+	// put: `m k v put`, set the value of a key (the map stays on the stack)
+	{"put", WORD_HEADER {
+		if (env.stack.size() < 3) return STACK_UNDERFLOW;
+		Object* val	= pop(env.stack);
+		Object* key	= pop(env.stack);
+		Object* map	= env.stack.back();
+		if (map->type() != Object::Map || !HashMap::valid_key(key)) {
+			delete val; delete key;
+			return TYPE_MISMATCH;
+		}
+		value<HashMap>(map).put(key, val);
+		delete key;
+		return SUCCESS;
+	}},
+
+	// get: `m k get`, the value of a key
+	{"get", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* key	= pop(env.stack);
+		Object* map	= pop(env.stack);
+		if (map->type() != Object::Map || !HashMap::valid_key(key)) {
+			delete key; delete map;
+			return TYPE_MISMATCH;
+		}
+		Object* result = ((OTMap*)map)->table().get(key);
+		delete key; delete map;
+		if (!result) return INCORRECT_VALUE;
+		env.stack.push_back(result);
+		return SUCCESS;
+	}},
+
+	// has: `m k has`, 1 if the key is in the map, 0 otherwise
+	{"has", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* key	= pop(env.stack);
+		Object* map	= pop(env.stack);
+		if (map->type() != Object::Map || !HashMap::valid_key(key)) {
+			delete key; delete map;
+			return TYPE_MISMATCH;
+		}
+		bool result = ((OTMap*)map)->table().has(key);
+		delete key; delete map;
+		env.stack.push_back(new OTInt(result));
+		return SUCCESS;
+	}},
+
+	// keys: list of the keys of a map
+	{"keys", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* map = pop(env.stack);
+		if (map->type() != Object::Map) {
+			delete map;
+			return TYPE_MISMATCH;
+		}
+		OTList* result = new OTList();
+		value<std::vector<Object*>>(result) = ((OTMap*)map)->table().keys();
+		delete map;
+		env.stack.push_back(result);
+		return SUCCESS;
+	}},
+
 // STRING OPERATIONS
+	// length: the number of items in a list or array, or of bytes in a string
+	{"length", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* seq = pop(env.stack);
+		if (!(is_sequence(seq) || seq->type() == Object::String)) {
+			delete seq;
+			return TYPE_MISMATCH;
+		}
+		env.stack.push_back(new OTInt((int64_t)sliceable_size(seq)));
+		delete seq;
+		return SUCCESS;
+	}},
+
+	// find: `s sub find`, the index of the first occurrence of sub in s, or -1
+	{"find", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* sub	= pop(env.stack);
+		Object* s	= pop(env.stack);
+		if (s->type() != Object::String || sub->type() != Object::String) {
+			delete sub; delete s;
+			return TYPE_MISMATCH;
+		}
+		size_t i = find_text(((OTString*)s)->view(), ((OTString*)sub)->view());
+		delete sub; delete s;
+		env.stack.push_back(new OTInt(i == std::string_view::npos ? -1 : (int64_t)i));
+		return SUCCESS;
+	}},
+
+	// split: `s sep split`, list of the parts of s between the separators (views, not copies)
+	{"split", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* sep	= pop(env.stack);
+		Object* s	= pop(env.stack);
+		if (s->type() != Object::String || sep->type() != Object::String) {
+			delete sep; delete s;
+			return TYPE_MISMATCH;
+		}
+		std::string_view text = ((OTString*)s)->view(), separator = ((OTString*)sep)->view();
+		if (separator.empty()) {
+			delete sep; delete s;
+			return INCORRECT_VALUE;
+		}
+		OTList* result = new OTList();
+		std::vector<Object*>& parts = value<std::vector<Object*>>(result);
+		size_t from = 0;
+		for (;;) {
+			size_t to = find_text(text, separator, from);
+			if (to == std::string_view::npos) to = text.size();
+			parts.push_back(new OTString(*(OTString*)s, from, to - from));
+			if (to == text.size()) break;
+			from = to + separator.size();
+		}
+		delete sep; delete s;
+		env.stack.push_back(result);
+		return SUCCESS;
+	}},
+
+	// join: `l sep join`, the strings of a list with sep between them
+	// (`t join` waits for a task, see spawn)
+	{"join", WORD_HEADER {
+		if (env.stack.size() >= 1 && env.stack.back()->type() == Object::Task) {
+			Object* t = pop(env.stack);
+			OTList* result = new OTList();
+			Error e = value<Task>(t).join(value<std::vector<Object*>>(result), env.deadline);
+			delete t;
+			if (e != SUCCESS) {
+				delete result;
+				return e;
+			}
+			env.stack.push_back(result);
+			return SUCCESS;
+		}
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* sep	= pop(env.stack);
+		Object* l	= pop(env.stack);
+		if (l->type() != Object::List || sep->type() != Object::String) {
+			delete sep; delete l;
+			return TYPE_MISMATCH;
+		}
+		OTList* list = (OTList*)l;
+		std::string_view separator = ((OTString*)sep)->view();
+		size_t length = 0;
+		for (size_t i = 0; i < list->size(); i++) {
+			if (list->at(i)->type() != Object::String) {
+				delete sep; delete l;
+				return TYPE_MISMATCH;
+			}
+			length += ((const OTString*)list->at(i))->view().size() + (i ? separator.size() : 0);
+		}
+		std::string result;
+		result.reserve(length);
+		for (size_t i = 0; i < list->size(); i++) {
+			if (i) result.append(separator);
+			result.append(((const OTString*)list->at(i))->view());
+		}
+		delete sep; delete l;
+		env.stack.push_back(new OTString(std::move(result)));
+		return SUCCESS;
+	}},
+
+	// replace: `s old new replace`, every occurrence of old replaced with new
+	{"replace", WORD_HEADER {
+		if (env.stack.size() < 3) return STACK_UNDERFLOW;
+		Object* with	= pop(env.stack);
+		Object* old		= pop(env.stack);
+		Object* s		= pop(env.stack);
+		if (s->type() != Object::String || old->type() != Object::String || with->type() != Object::String) {
+			delete with; delete old; delete s;
+			return TYPE_MISMATCH;
+		}
+		std::string_view text = ((OTString*)s)->view(), pattern = ((OTString*)old)->view(), replacement = ((OTString*)with)->view();
+		if (pattern.empty()) {
+			delete with; delete old; delete s;
+			return INCORRECT_VALUE;
+		}
+		size_t at = find_text(text, pattern);
+		if (at == std::string_view::npos) {
+			// nothing to replace, the original string is kept
+			delete with; delete old;
+			env.stack.push_back(s);
+			return SUCCESS;
+		}
+		std::string result;
+		size_t from = 0;
+		for (; at != std::string_view::npos; at = find_text(text, pattern, from)) {
+			result.append(text.substr(from, at - from));
+			result.append(replacement);
+			from = at + pattern.size();
+			// the result can be much longer than the text
+			if (memory_exceeded()) {
+				delete with; delete old; delete s;
+				return OUT_OF_MEMORY;
+			}
+		}
+		result.append(text.substr(from));
+		delete with; delete old; delete s;
+		env.stack.push_back(new OTString(std::move(result)));
+		return SUCCESS;
+	}},
+
+	// upper: ASCII letters to upper case
+	{"upper", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* s = pop(env.stack);
+		if (s->type() != Object::String) {
+			delete s;
+			return TYPE_MISMATCH;
+		}
+		// in place, unless the contents are shared with another string
+		to_upper(value<std::string>(s));
+		env.stack.push_back(s);
+		return SUCCESS;
+	}},
+
+	// lower: ASCII letters to lower case
+	{"lower", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* s = pop(env.stack);
+		if (s->type() != Object::String) {
+			delete s;
+			return TYPE_MISMATCH;
+		}
+		// in place, unless the contents are shared with another string
+		to_lower(value<std::string>(s));
+		env.stack.push_back(s);
+		return SUCCESS;
+	}},
+
+	// trim: a view of a string without the leading and trailing whitespace
+	{"trim", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* s = pop(env.stack);
+		if (s->type() != Object::String) {
+			delete s;
+			return TYPE_MISMATCH;
+		}
+		std::string_view text = ((OTString*)s)->view();
+		constexpr std::string_view space = " \t\n\v\f\r";
+		size_t from = text.find_first_not_of(space);
+		size_t count = from == std::string_view::npos ? 0 : text.find_last_not_of(space) + 1 - from;
+		env.stack.push_back(new OTString(*(OTString*)s, from == std::string_view::npos ? 0 : from, count));
+		delete s;
+		return SUCCESS;
+	}},
 
 // STACK OPERATIONS
 	// dup: duplicating the item on top of the stack
@@ -342,11 +1214,110 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 	{"drop", WORD_HEADER {
 		if (env.stack.size() < 1) return STACK_UNDERFLOW;
 		Object* o = pop(env.stack);
-		delete o; 
+		delete o;
+		return SUCCESS;
+	}},
+
+	// swap: exchange the two items on top of the stack
+	{"swap", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		std::swap(env.stack[env.stack.size() - 1], env.stack[env.stack.size() - 2]);
+		return SUCCESS;
+	}},
+
+	// over: copy the second item to the top (`a b -- a b a`)
+	{"over", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		env.stack.push_back(env.stack[env.stack.size() - 2]->clone());
+		return SUCCESS;
+	}},
+
+	// rot: move the third item to the top (`a b c -- b c a`)
+	{"rot", WORD_HEADER {
+		if (env.stack.size() < 3) return STACK_UNDERFLOW;
+		std::rotate(env.stack.end() - 3, env.stack.end() - 2, env.stack.end());
 		return SUCCESS;
 	}},
 
 // CONTROL FLOW
+	// times: `n [ body ] times`, run the body n times
+	{"times", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* body	= pop(env.stack);
+		Object* n		= pop(env.stack);
+		if (body->type() != Object::Block || n->type() != Object::Int) {
+			delete body; delete n;
+			return TYPE_MISMATCH;
+		}
+		int64_t count = value<int64_t>(n);
+		delete n;
+		OTBlock const& code = *(OTBlock*)body;
+		Error e = SUCCESS;
+		for (int64_t i = 0; i < count && e == SUCCESS; i++)
+			e = execute_block(env, code);
+		delete body;
+		return e;
+	}},
+
+	// while: `[ cond ] [ body ] while`, run the body as long as cond leaves a non-zero int
+	{"while", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* body	= pop(env.stack);
+		Object* cond	= pop(env.stack);
+		if (body->type() != Object::Block || cond->type() != Object::Block) {
+			delete body; delete cond;
+			return TYPE_MISMATCH;
+		}
+		OTBlock const& cond_code = *(OTBlock*)cond;
+		OTBlock const& body_code = *(OTBlock*)body;
+		Error e;
+		for (;;) {
+			if ((e = execute_block(env, cond_code)) != SUCCESS) break;
+			if (env.stack.size() < 1) {
+				e = STACK_UNDERFLOW;
+				break;
+			}
+			Object* predicate = pop(env.stack);
+			bool go_on = predicate->type() == Object::Int && value<int64_t>(predicate);
+			if (predicate->type() != Object::Int) e = TYPE_MISMATCH;
+			delete predicate;
+			if (!go_on) break;
+			if ((e = execute_block(env, body_code)) != SUCCESS) break;
+		}
+		delete body; delete cond;
+		return e;
+	}},
+
+	// each: `s [ body ] each`, run the body for every item, with the item on the stack
+	{"each", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* body	= pop(env.stack);
+		Object* seq		= pop(env.stack);
+		if (body->type() != Object::Block || !(is_sequence(seq) || seq->type() == Object::Stream)) {
+			delete body; delete seq;
+			return TYPE_MISMATCH;
+		}
+		OTBlock const& code = *(OTBlock*)body;
+		Error e = SUCCESS;
+		if (seq->type() == Object::Stream) {
+			Source& source = *((OTStream*)seq)->source();
+			Object* item;
+			while ((e = source.next(item)) == SUCCESS && item) {
+				env.stack.push_back(item);
+				if ((e = execute_block(env, code)) != SUCCESS) break;
+			}
+		} else {
+			size_t size = sequence_size(seq);
+			for (size_t i = 0; i < size && e == SUCCESS; i++) {
+				env.stack.push_back(sequence_at(seq, i));
+				e = execute_block(env, code);
+			}
+		}
+		delete body; delete seq;
+		return e;
+	}},
+
+
 	// if: conditionally select next block
 	{"if", WORD_HEADER {
 		if (env.stack.size() < 3) return STACK_UNDERFLOW;
@@ -356,7 +1327,7 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 		if (predicate->type() == Object::Int
 			&& if_true->type() == Object::Block
 			&& if_false->type() == Object::Block) {
-			Error e = execute_block(env, value<std::vector<Object*>>(value<int64_t>(predicate) ? if_true : if_false));
+			Error e = execute_block(env, *(OTBlock*)(value<int64_t>(predicate) ? if_true : if_false));
 			delete predicate; delete if_true; delete if_false;
 			return e;
 		} else {
@@ -364,44 +1335,254 @@ static const std::unordered_map<std::string, Word> builtin_words = {
 			return TYPE_MISMATCH;
 		}
 	}},
+
+// TASKS
+	// spawn: `x1 .. xn n [ body ] spawn`, run the body in parallel, on a new stack holding x1 .. xn
+	// (the items are moved, not copied; streams cannot be passed); not available in server mode
+	{"spawn", WORD_HEADER {
+		if (!env.tasks) return NOT_IMPLEMENTED;
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* body	= pop(env.stack);
+		Object* n		= pop(env.stack);
+		if (body->type() != Object::Block || n->type() != Object::Int) {
+			delete body; delete n;
+			return TYPE_MISMATCH;
+		}
+		int64_t count = value<int64_t>(n);
+		delete n;
+		if (count < 0 || (uint64_t)count > env.stack.size()) {
+			delete body;
+			return count < 0 ? INCORRECT_VALUE : STACK_UNDERFLOW;
+		}
+		Stack args(env.stack.end() - count, env.stack.end());
+		for (Object* o: args) {
+			if (!is_transferable(o)) {
+				delete body;
+				return TYPE_MISMATCH;
+			}
+		}
+		env.stack.resize(env.stack.size() - count);
+		std::shared_ptr<Task> task = spawn_task(env, body, std::move(args));
+		if (!task) return OUT_OF_MEMORY;
+		env.stack.push_back(new OTTask(std::move(task)));
+		return SUCCESS;
+	}},
+
+	// chan: `capacity chan`, a channel holding at most capacity items (rounded up to a power of two);
+	// the buffer is allocated up front, so the capacity is limited to Channel::MAX_CAPACITY (2^20)
+	{"chan", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* n = pop(env.stack);
+		if (n->type() != Object::Int) {
+			delete n;
+			return TYPE_MISMATCH;
+		}
+		int64_t capacity = value<int64_t>(n);
+		delete n;
+		if (capacity < 1 || (uint64_t)capacity > Channel::MAX_CAPACITY) return INCORRECT_VALUE;
+		env.stack.push_back(new OTChannel(std::make_shared<Channel>((size_t)capacity)));
+		return SUCCESS;
+	}},
+
+	// send: `c x send`, move x into the channel, waiting while it is full (the channel stays on the stack)
+	{"send", WORD_HEADER {
+		if (env.stack.size() < 2) return STACK_UNDERFLOW;
+		Object* x = pop(env.stack);
+		Object* c = env.stack.back();
+		if (c->type() != Object::Channel || !is_transferable(x)) {
+			delete x;
+			return TYPE_MISMATCH;
+		}
+		x->freeze();
+		Error e = value<Channel>(c).send(x, env.deadline);
+		if (e != SUCCESS) delete x;
+		return e;
+	}},
+
+	// recv: `c recv`, take the oldest item of the channel, waiting while it is empty (the channel stays on the stack)
+	{"recv", WORD_HEADER {
+		if (env.stack.size() < 1) return STACK_UNDERFLOW;
+		Object* c = env.stack.back();
+		if (c->type() != Object::Channel) return TYPE_MISMATCH;
+		Object* x;
+		Error e = value<Channel>(c).receive(x, env.deadline);
+		if (e != SUCCESS) return e;
+		env.stack.push_back(x);
+		return SUCCESS;
+	}},
+};
+
+/// A blokkot futtató beépített szavak, lásd builtin_blocks(). Új ilyen szót ide is fel kell venni.
+static constexpr std::pair<std::string_view, size_t> block_words[] = {
+	{"map", 1}, {"sort-by", 1}, {"grade-by", 1}, {"times", 1}, {"while", 2}, {"if", 2},
+	// a stream may run the blocks of a lazy map made anywhere
+	{"reduce1", SIZE_MAX}, {"each", SIZE_MAX}, {"collect", SIZE_MAX},
 };
 
+/// A beépített szavak száma.
+static constexpr size_t BUILTIN_COUNT = sizeof(builtin_words) / sizeof(builtin_words[0]);
+
+/// Különbözik-e minden beépített szó neve (azonos nevekre nincs ütközésmentes \c seed).
+static constexpr bool builtin_names_unique(void) {
+	for (size_t i = 0; i < BUILTIN_COUNT; i++)
+		for (size_t j = i + 1; j < BUILTIN_COUNT; j++)
+			if (builtin_words[i].name == builtin_words[j].name) return false;
+	return true;
+}
+static_assert(builtin_names_unique(), "builtin_words contains the same name twice");
+
+/// Beépített szavak tökéletes hash táblája.
+/**
+ * A táblában minden szó a saját helyén van (nincs ütközés), így egy keresés 
+ * egy hash számításból és egy összehasonlításból áll.
+ */
+struct BuiltinTable {
+	/// A tábla mérete: kettő hatványa, a szavak számánál jóval nagyobb, hogy
+	/// hamar találjunk ütközésmentes \c seed -et.
+	static constexpr size_t SIZE = [] {
+		size_t size = 1;
+		while (size < 16 * BUILTIN_COUNT) size *= 2;
+		return size;
+	}();
+
+	/// A hash függvény paramétere.
+	uint64_t seed = 0;
+	/// A szó indexe builtin_words -ben, vagy -1, ha üres a hely.
+	int16_t slots[SIZE] = {};
+
+	/// Szó hash-e (FNV-1a, a végén keveréssel).
+	static constexpr uint64_t hash(std::string_view s, uint64_t seed) {
+		uint64_t h = 0xcbf29ce484222325ull ^ seed;
+		for (char c: s) {
+			h ^= (unsigned char)c;
+			h *= 0x100000001b3ull;
+		}
+		h ^= h >> 29; h *= 0xbf58476d1ce4e5b9ull; h ^= h >> 32;
+		return h;
+	}
+
+	/// A tábla elkészítése: addig próbál \c seed -eket, amíg nincs ütközés.
+	static constexpr BuiltinTable build(void) {
+		// the static_assert above reports this, the search would never end
+		if (!builtin_names_unique()) return BuiltinTable{};
+		for (uint64_t seed = 1; ; seed++) {
+			BuiltinTable t;
+			t.seed = seed;
+			for (size_t i = 0; i < SIZE; i++) t.slots[i] = -1;
+			bool collision = false;
+			for (size_t i = 0; i < BUILTIN_COUNT && !collision; i++) {
+				int16_t& slot = t.slots[hash(builtin_words[i].name, seed) & (SIZE - 1)];
+				if (slot >= 0) collision = true;
+				slot = (int16_t)i;
+			}
+			if (!collision) return t;
+		}
+	}
+
+	/// Beépített szó indexe builtin_words -ben.
+	/// @returns Az index, vagy -1, ha nincs ilyen beépített szó.
+	constexpr int16_t index(std::string_view name) const {
+		int16_t i = slots[hash(name, seed) & (SIZE - 1)];
+		return (i >= 0 && builtin_words[i].name == name) ? i : -1;
+	}
+
+	/// Beépített szó keresése.
+	/// @returns A szót futtató függvény, vagy \c nullptr, ha nincs ilyen beépített szó.
+	constexpr Word find(std::string_view name) const {
+		int16_t i = index(name);
+		return i >= 0 ? builtin_words[i].fn : nullptr;
+	}
+};
+
+/// A beépített szavak keresőtáblája, fordításkor készül.
+static constexpr BuiltinTable builtin_table = BuiltinTable::build();
+
+/// Ennyi szavanként nézi meg, hogy lejárt-e a futásra szánt idő.
+static constexpr size_t DEADLINE_CHECK_INTERVAL = 1024;
+
+/// Futtatott szó kezdetének jelzése a figyelő eszközöknek.
+/// @param builtin A szó indexe builtin_words -ben, vagy -1, ha nem beépített.
+/// @note Külön függvényben, hogy figyelés nélkül ne lassítsa a futtatást.
+__attribute__((noinline))
+static void instrument_enter(Environment& env, int16_t builtin, std::string const& name) {
+	Instruments& i = *env.instruments;
+	if (i.trace) i.trace->record(builtin >= 0 ? (uint32_t)builtin : i.trace->symbols.intern(name), env.stack.size());
+	if (i.counters) i.counters->enter(builtin >= 0 ? (uint32_t)builtin : i.counters->symbols.intern(name));
+	if (i.sampler) i.sampler->enter_word(builtin >= 0 ? (uint32_t)builtin : i.sampler->symbols.intern(name));
+}
+
+/// Futtatott szó végének jelzése a figyelő eszközöknek.
+__attribute__((noinline))
+static void instrument_leave(Environment& env) {
+	Instruments& i = *env.instruments;
+	if (i.counters) i.counters->leave();
+	if (i.sampler) i.sampler->leave();
+}
+
+/// Hibánál a beillesztett szavak kiírása, amelyek törzséből az elem származik (lásd OTWord::inlined).
+static void unwind_inlined(Environment& env, const Object* o) {
+	if (o->type() != Object::Word || !((const OTWord*)o)->inlined) return;
+	for (std::string const& name: *((const OTWord*)o)->inlined)
+		env.out << "Running word " << name << "\n";
+}
+
 /// Egy blokk futtatása.
 /**
  *	Lefuttat egy blokkot, azaz sorrendben mindegyik elemre végrehajtja a 
  *	megfelelő utasítást.
  *	@param env A futtatási környezet.
  *	@param block A lefuttatandó blokk.
+ *	@param from Ettől az elemtől kezdve (pl. a JIT kódjának visszalépése után).
  *	@returns A futtatásból származó hiba.
  */
-static Error execute_block(Environment& env, Block const& block) {
+static Error execute_block(Environment& env, Block const& block, size_t from) {
 	Error e;
-	for (Object* o: block) {
+	for (size_t i = from; i < block.size(); i++) {
+		Object* o = block[i];
 		switch (o->type()) {
 			case Object::Block: case Object::Int: case Object::Float: case Object::String: case Object::List:
+			case Object::Array: case Object::Stream: case Object::Map: case Object::Task: case Object::Channel:
 				env.stack.push_back(o->clone());
 				break;
 			case Object::Word:
-				std::string val = std::string(*(std::string*)o->get_value());
+				// only words run long or allocate much, so the limits are checked before them
+				if (env.deadline && ++env.steps % DEADLINE_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() > *env.deadline) {
+					unwind_inlined(env, o);
+					return TIMEOUT;
+				}
+				if (env.memory_limit && memory_exceeded()) {
+					unwind_inlined(env, o);
+					return OUT_OF_MEMORY;
+				}
+				std::string const& val = *(std::string*)o->get_value();
 				if (val.front() == '\'') {
 					if (env.stack.size() < 1) return STACK_UNDERFLOW;
 					Object* o2 = pop(env.stack);
-					if (o2->type() != Object::Block)
+					if (o2->type() != Object::Block) {
+						delete o2;
 						return TYPE_MISMATCH;
-
-					std::string new_word = val.substr(1);
-					env.defined_words[new_word] = std::vector<Object*>();
-					for (Object* obj: *(std::vector<Object*>*)o2->get_value()) {
-						env.defined_words[new_word].push_back(obj->clone());
-						delete obj;
 					}
+
+					env.defined_words.define(val.substr(1), value<Block>(o2));
+					delete o2;
 				} else {
-					e = (builtin_words.find(val) != builtin_words.end()) ? builtin_words.at(val)(env)
-						: (env.defined_words.find(val) != env.defined_words.end()) ? execute_block(env, env.defined_words.at(val))
-						: UNDEFINED_WORD;
+					int16_t builtin = builtin_table.index(val);
+					if (env.instruments) instrument_enter(env, builtin, val);
+					const OTBlock* defined;
+					if (builtin >= 0) {
+						e = builtin_words[builtin].fn(env);
+					} else if ((defined = env.defined_words.find(val))) {
+						// keep the body alive, even if the word is redefined while it runs
+						OTBlock body = *defined;
+						e = env.jit ? env.jit->call(env, body) : execute_block(env, value<Block>(&body));
+					} else {
+						e = UNDEFINED_WORD;
+					}
+					if (env.instruments) instrument_leave(env);
 
 					if (e != SUCCESS) {
-						std::cout << "Running word " << val << "\n";
+						env.out << "Running word " << val << "\n";
+						unwind_inlined(env, o);
 						return e;
 					}
 				}
@@ -411,8 +1592,48 @@ static Error execute_block(Environment& env, Block const& block) {
 	return SUCCESS;
 };
 
-Error interpret(std::vector<Object*> const& code) {
-	Stack s; std::unordered_map<std::string, Block> w;
+/// Blokk objektum futtatása.
+/**
+ * Mint execute_block(Environment&, Block const&), de mintavételezéskor a
+ * blokk (a forrásbeli helyével) a logikai hívási verem egy eleme. A gyakran
+ * futtatott blokkokat (pl. egy \c times törzsét) a JIT lefordítja.
+ */
+static Error execute_block(Environment& env, OTBlock const& block) {
+	Block const& code = *(const Block*)block.get_value();
+	Sampler* sampler = env.instruments ? env.instruments->sampler : nullptr;
+	if (!sampler) return env.jit ? env.jit->call(env, block) : execute_block(env, code);
+	sampler->enter_block(block.location);
+	Error e = execute_block(env, code);
+	sampler->leave();
+	return e;
+}
+
+bool is_builtin(std::string const& name) {
+	return builtin_table.find(name) != nullptr;
+}
+
+Word find_builtin(std::string_view name) {
+	return builtin_table.find(name);
+}
+
+size_t builtin_blocks(std::string_view name) {
+	for (auto const& [word, blocks]: block_words)
+		if (word == name) return blocks;
+	return 0;
+}
+
+Error resume_block(Environment& env, Block const& block, size_t from) {
+	return execute_block(env, block, from);
+}
+
+std::vector<std::string_view> builtin_names(void) {
+	std::vector<std::string_view> names;
+	for (Builtin const& b: builtin_words) names.push_back(b.name);
+	return names;
+}
+
+Error interpret(std::vector<Object*> const& code, Options const& options) {
+	Stack s; Dictionary w(options.inline_threshold);
 	Environment env{s, w};
 	Error e = execute_block(env, code);
 	for (Object* o: s)
@@ -420,3 +1641,7 @@ Error interpret(std::vector<Object*> const& code) {
 	return e;
 }
 
+Error interpret(std::vector<Object*> const& code, Environment& env) {
+	return execute_block(env, code);
+}
+
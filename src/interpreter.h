@@ -7,8 +7,18 @@
 
 #include <vector>
 #include <unordered_map>
+#include <iostream>
+#include <optional>
+#include <chrono>
+#include <string_view>
 
 #include "parser.h"
+#include "dictionary.h"
+
+class Tracer;
+class Counters;
+class Sampler;
+class Jit;
 
 /// @{
 /// Szemantikai sugallatú alias-ok.
@@ -16,10 +26,49 @@ using Stack = std::vector<Object*>;
 using Block = std::vector<Object*>;
 /// @}
 
+/// A futást figyelő eszközök (nyomkövetés, profilozás).
+/**
+ * Külön struktúrában vannak, hogy figyelés nélkül a futtatásnak csak egy
+ * mutatót kelljen megnéznie szavanként.
+ */
+struct Instruments {
+	/// Ha meg van adva, minden futtatott szót ide rögzít.
+	Tracer* trace = nullptr;
+	/// Ha meg van adva, minden futtatott szó teljesítményszámlálóit ide méri.
+	Counters* counters = nullptr;
+	/// Ha meg van adva, a futó szavakat és blokkokat (a logikai hívási vermet) ide jelzi.
+	Sampler* sampler = nullptr;
+};
+
 /// Program futtatásának környezete.
 struct Environment {
 	Stack& stack;
-	std::unordered_map<std::string, Block>& defined_words;
+	Dictionary& defined_words;
+	/// A kiíró szavak ide írnak.
+	std::ostream& out = std::cout;
+	/// Ha meg van adva, ezután a futás \c TIMEOUT hibával megszakad.
+	std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+	/// Ha meg van adva, a futtatott szavakat ezek figyelik.
+	Instruments* instruments = nullptr;
+	/// Ha meg van adva, a gyakran hívott szavakat ez fordítja gépi kódra (figyelés és határidő nélkül).
+	Jit* jit = nullptr;
+	/// Indíthat-e párhuzamos feladatot (\c spawn); szerver módban nem, mert a feladat túlélné a kérést.
+	bool tasks = true;
+	/// Minden szó előtt ellenőrzi-e a szál memóriakorlátját (lásd memory_exceeded()).
+	bool memory_limit = false;
+	/// A futtatott szavak száma, a határidőt csak minden sokadiknál ellenőrzi.
+	size_t steps = 0;
+
+	/// Ugyanilyen környezet egy másik veremmel (pl. blokkok elemenkénti futtatásához).
+	Environment with_stack(Stack& s) const {
+		return Environment{s, defined_words, out, deadline, instruments, jit, tasks, memory_limit};
+	}
+};
+
+/// Program futtatásának beállításai.
+struct Options {
+	/// Az ennél nem nagyobb törzsű szavakat a definiáláskor beilleszti a hívásuk helyére, 0 esetén soha.
+	size_t inline_threshold = Dictionary::DEFAULT_INLINE_THRESHOLD;
 };
 
 /// Futás közben előforduló hibák.
@@ -30,19 +79,69 @@ enum Error {
 	NOT_IMPLEMENTED,
 	UNDEFINED_WORD,
 	INCORRECT_VALUE,
+	IO_ERROR,
+	/// Lejárt a futásra szánt idő (Environment::deadline).
+	TIMEOUT,
+	/// Elfogyott a futásra szánt memória (lásd set_memory_limit()).
+	OUT_OF_MEMORY,
+	/// Hibás forrás (a tokenizálás vagy a szintaktikai analízis sikertelen).
+	SYNTAX_ERROR,
+};
+
+/// Lusta sorozat (Object::Stream) elemeinek forrása.
+class Source {
+public:
+	/// Következő elem előállítása.
+	/**
+	 * @param[out] out A következő elem, amelyet a hívó birtokol, vagy \c nullptr, ha
+	 * 				   a sorozat véget ért.
+	 * @returns Az elem előállítása közben felmerülő hiba.
+	 */
+	virtual Error next(Object*& out) = 0;
+
+	virtual ~Source(void) {}
 };
 
 /// Beépített szavakat futtató függvények típusa.
 using Word = Error (*)( Environment& ); 
 
+/// Beépített szó-e.
+/// @param name A szó neve.
+bool is_builtin(std::string const& name);
+
+/// Beépített szó keresése.
+/// @returns A szót futtató függvény, vagy \c nullptr, ha nincs ilyen beépített szó.
+Word find_builtin(std::string_view name);
+
+/// Hány, a verem tetején kapott blokkot futtat a beépített szó (pl. \c if kettőt).
+/// @returns \c SIZE_MAX, ha bármilyen kódot futtathat (pl. egy lusta sorozat elemeivel).
+size_t builtin_blocks(std::string_view name);
+
+/// Blokk futtatásának folytatása egy adott elemtől (a JIT kódjának visszalépése után).
+Error resume_block(Environment& env, std::vector<Object*> const& block, size_t from);
+
+/// A beépített szavak nevei, a nyomkövetésben használt azonosítójuk (Tracer) szerint.
+std::vector<std::string_view> builtin_names(void);
+
 /// Program futtatása.
 /**
  * Szintaktikailag analizált program lefuttatása. Kezeli a futó program környezetét,
  * és a felmerülő hibákat.
  * @param code A futtatandó objektumok listája.
+ * @param options A futtatás beállításai.
+ * @returns A futtatott program hibaüzenete.
+ */
+Error interpret(std::vector<Object*> const& code, Options const& options = Options());
+
+/// Program futtatása egy meglévő környezetben.
+/**
+ * A verem és a definiált szavak a futás után is megmaradnak (pl. a következő
+ * programhoz).
+ * @param code A futtatandó objektumok listája.
+ * @param env A futtatás környezete.
  * @returns A futtatott program hibaüzenete.
  */
-Error interpret(std::vector<Object*> const& code);
+Error interpret(std::vector<Object*> const& code, Environment& env);
 
 #endif
 
@@ -0,0 +1,228 @@
+/**
+ * @file
+ * @brief Fájlkezelés implementáció.
+ */
+#include <vector>
+#include <cstring>
+#include <charconv>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "io.h"
+
+std::shared_ptr<MappedBuffer> MappedBuffer::open(std::string const& path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return nullptr;
+	}
+
+	// mmap-ing an empty file is an error, but an empty buffer is fine
+	size_t length = (size_t)st.st_size;
+	if (length == 0) {
+		::close(fd);
+		return std::shared_ptr<MappedBuffer>(new MappedBuffer(nullptr, 0));
+	}
+
+	void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+	// the mapping keeps the file referenced, the descriptor is not needed anymore
+	::close(fd);
+	if (addr == MAP_FAILED) return nullptr;
+
+	// the data is usually processed front to back, let the kernel read ahead
+	(void)madvise(addr, length, MADV_SEQUENTIAL);
+	return std::shared_ptr<MappedBuffer>(new MappedBuffer(addr, length));
+}
+
+MappedBuffer::~MappedBuffer(void) {
+	if (addr) munmap(addr, length);
+}
+
+/// A FileWriter pufferének mérete.
+static constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+FileWriter::FileWriter(std::string const& path)
+	: fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), used(0), failed(fd < 0), buffer(new char[WRITE_BUFFER_SIZE]) {}
+
+/// Teljes puffer kiírása (a \c write rendszerhívás kevesebbet is írhat).
+static bool write_all(int fd, const char* data, size_t bytes) {
+	while (bytes > 0) {
+		ssize_t written = ::write(fd, data, bytes);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		data += written; bytes -= (size_t)written;
+	}
+	return true;
+}
+
+void FileWriter::write(const void* data, size_t bytes) {
+	if (failed) return;
+	const char* p = (const char*)data;
+
+	// large writes bypass the buffer
+	if (bytes >= WRITE_BUFFER_SIZE) {
+		failed = !write_all(fd, buffer, used) || !write_all(fd, p, bytes);
+		used = 0;
+		return;
+	}
+
+	if (used + bytes > WRITE_BUFFER_SIZE) {
+		failed = !write_all(fd, buffer, used);
+		used = 0;
+	}
+	memcpy(buffer + used, p, bytes);
+	used += bytes;
+}
+
+bool FileWriter::close(void) {
+	if (fd < 0) return false;
+	if (!failed) failed = !write_all(fd, buffer, used);
+	used = 0;
+	if (::close(fd) != 0) failed = true;
+	fd = -1;
+	return !failed;
+}
+
+FileWriter::~FileWriter(void) {
+	if (fd >= 0) (void)close();
+	delete[] buffer;
+}
+
+/// A LineReader pufferének kezdeti mérete.
+static constexpr size_t READ_BUFFER_SIZE = 1 << 20;
+
+LineReader::LineReader(int fd, bool owned)
+	: fd(fd), owned(owned), buffer(new char[READ_BUFFER_SIZE]), capacity(READ_BUFFER_SIZE),
+	  begin(0), scanned(0), end(0), eof(false), error(false) {
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+std::unique_ptr<LineReader> LineReader::open(std::string const& path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return nullptr;
+	return std::make_unique<LineReader>(fd, true);
+}
+
+bool LineReader::next(std::string_view& line) {
+	for (;;) {
+		// look for the end of the line in the part not yet scanned
+		const char* nl = (const char*)memchr(buffer + scanned, '\n', end - scanned);
+		if (nl || (eof && begin < end)) {
+			size_t line_end = nl ? (size_t)(nl - buffer) : end;
+			size_t length = line_end - begin;
+			if (length > 0 && buffer[begin + length - 1] == '\r') --length;
+			line = std::string_view(buffer + begin, length);
+			begin = scanned = nl ? line_end + 1 : end;
+			return true;
+		}
+		if (eof || error) return false;
+
+		// move the partial line to the front, grow the buffer if it is full
+		if (begin > 0) {
+			memmove(buffer, buffer + begin, end - begin);
+			end -= begin; begin = 0;
+		}
+		scanned = end;
+		if (end == capacity) {
+			char* bigger = new char[capacity * 2];
+			memcpy(bigger, buffer, end);
+			delete[] buffer;
+			buffer = bigger; capacity *= 2;
+		}
+
+		ssize_t r = ::read(fd, buffer + end, capacity - end);
+		if (r < 0) {
+			if (errno != EINTR) error = true;
+		} else if (r == 0) {
+			eof = true;
+		} else {
+			end += (size_t)r;
+		}
+	}
+}
+
+LineReader::~LineReader(void) {
+	if (owned) ::close(fd);
+	delete[] buffer;
+}
+
+/// Mező elejéről és végéről a szóközök levágása.
+static void trim_field(const char*& begin, const char*& end) {
+	while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+	while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) --end;
+}
+
+std::optional<OTArray> read_csv_column(MappedBuffer const& file, size_t column) {
+	std::vector<int64_t> ints;
+	std::vector<double> floats;
+	bool all_ints = true;
+
+	const char* p = (const char*)file.data();
+	const char* const end = p + file.size();
+	bool first_line = true;
+
+	while (p < end) {
+		const char* line_end = (const char*)memchr(p, '\n', end - p);
+		if (!line_end) line_end = end;
+
+		// find the requested field
+		const char* field = p;
+		for (size_t i = 0; i < column && field; i++) {
+			field = (const char*)memchr(field, ',', line_end - field);
+			if (field) ++field;
+		}
+		const char* field_end = field ? (const char*)memchr(field, ',', line_end - field) : nullptr;
+		if (!field_end) field_end = line_end;
+
+		bool empty_line = (p == line_end) || (p + 1 == line_end && *p == '\r');
+		p = line_end + 1;
+		if (empty_line) continue;
+
+		if (!field) {
+			// a header may have fewer columns, anything else is malformed
+			if (first_line) { first_line = false; continue; }
+			return std::nullopt;
+		}
+		trim_field(field, field_end);
+
+		int64_t n; double d;
+		if (all_ints) {
+			auto r = std::from_chars(field, field_end, n);
+			if (r.ec == std::errc() && r.ptr == field_end) {
+				ints.push_back(n);
+				first_line = false;
+				continue;
+			}
+		}
+
+		auto r = std::from_chars(field, field_end, d);
+		if (r.ec != std::errc() || r.ptr != field_end) {
+			// skip a textual header
+			if (first_line) { first_line = false; continue; }
+			return std::nullopt;
+		}
+		first_line = false;
+
+		// switch to floats at the first non-integer value
+		if (all_ints) {
+			all_ints = false;
+			floats.reserve(ints.size() + 1);
+			for (int64_t i: ints) floats.push_back((double)i);
+			ints = std::vector<int64_t>();
+		}
+		floats.push_back(d);
+	}
+
+	if (all_ints)
+		return OTArray(std::make_shared<OwnedBuffer<int64_t>>(std::move(ints)), Object::Int);
+	return OTArray(std::make_shared<OwnedBuffer<double>>(std::move(floats)), Object::Float);
+}
@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Fájlkezeléshez használt segédosztályok és -függvények.
+ */
+#ifndef IO_H
+#define IO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "parser.h"
+
+/// Memóriába leképezett fájl.
+/**
+ * A fájl tartalmát nem olvassa be, a lapokat az operációs rendszer tölti be
+ * a page cache-ből, amikor szükség van rájuk. Így a memóriánál nagyobb fájlok
+ * is használhatóak.
+ */
+class MappedBuffer: public ArrayBuffer {
+	void* addr;
+	size_t length;
+
+	MappedBuffer(void* a, size_t l): addr(a), length(l) {}
+public:
+	/// Fájl leképezése.
+	/**
+	 * @param path A fájl elérési útja.
+	 * @returns Siker esetén a leképezett fájl, hiba esetén \c nullptr (\c errno beállítva).
+	 */
+	static std::shared_ptr<MappedBuffer> open(std::string const& path);
+
+	MappedBuffer(MappedBuffer const&) = delete;
+	MappedBuffer& operator=(MappedBuffer const&) = delete;
+
+	const void* data(void) const override { return addr; }
+	size_t size(void) const override { return length; }
+
+	~MappedBuffer(void);
+};
+
+/// Pufferelt, bináris fájlba író osztály.
+class FileWriter {
+	int fd;
+	size_t used;
+	bool failed;
+	char* buffer;
+public:
+	/// @param path A létrehozandó (felülírandó) fájl elérési útja.
+	FileWriter(std::string const& path);
+
+	FileWriter(FileWriter const&) = delete;
+	FileWriter& operator=(FileWriter const&) = delete;
+
+	/// Adat hozzáfűzése a fájlhoz.
+	void write(const void* data, size_t bytes);
+
+	/// Puffer kiírása és a fájl lezárása.
+	/// @returns Sikeres volt-e minden írás.
+	bool close(void);
+
+	~FileWriter(void);
+};
+
+/// Soronként olvasó, nagy pufferrel dolgozó osztály.
+/**
+ * A sorokat a belső pufferből adja vissza, nem másolja őket, és nem foglal
+ * memóriát soronként. Állandó memóriában olvas akármekkora fájlt.
+ */
+class LineReader {
+	int fd;
+	bool owned;
+	char* buffer;
+	size_t capacity, begin, scanned, end;
+	bool eof, error;
+public:
+	/// @param fd Az olvasandó fájlleíró.
+	/// @param owned Lezárja-e az olvasó a fájlleírót.
+	LineReader(int fd, bool owned);
+
+	/// Fájl megnyitása olvasásra.
+	/// @returns Siker esetén az olvasó, hiba esetén \c nullptr (\c errno beállítva).
+	static std::unique_ptr<LineReader> open(std::string const& path);
+
+	LineReader(LineReader const&) = delete;
+	LineReader& operator=(LineReader const&) = delete;
+
+	/// Következő sor olvasása.
+	/**
+	 * @param[out] line A sor, a lezáró \c \\n (és \c \\r) nélkül. Csak a következő
+	 * 					hívásig érvényes.
+	 * @returns Volt-e még sor. Hiba esetén is \c false, lásd failed().
+	 */
+	bool next(std::string_view& line);
+
+	/// Történt-e olvasási hiba.
+	bool failed(void) const { return error; }
+
+	~LineReader(void);
+};
+
+/// Szöveges (CSV) fájl egy oszlopának beolvasása.
+/**
+ * A sorokat \c , választja el, az első sort fejlécnek tekinti, ha az adott oszlop
+ * nem szám. Az üres sorokat kihagyja.
+ * @param file A leképezett fájl.
+ * @param column Az oszlop indexe (0-tól).
+ * @returns Egész tömb, ha minden érték egész, különben valós tömb.
+ * 			Hibás érték esetén \code{.cpp} std::nullopt \endcode.
+ */
+std::optional<OTArray> read_csv_column(MappedBuffer const& file, size_t column);
+
+#endif
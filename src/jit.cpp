@@ -0,0 +1,470 @@
+/**
+ * @file
+ * @brief A JIT fordító implementációja.
+ *
+ * A lefordított törzs egy függvény (lásd Jit::Native), ami a törzs elemeit
+ * sorban C++ segédfüggvények és beépített szavak hívásával hajtja végre. A
+ * futása alatt \c rbx a környezet, \c r12 a hiba helye. Minden hívás után egy
+ * ugrás vezet a kilépési pontjához, ha hibát (vagy visszalépést) jelzett.
+ */
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+#include <string_view>
+
+#include "jit.h"
+#include "operators.h"
+
+Jit::~Jit(void) {
+	for (Chunk const& c: chunks) munmap(c.base, c.size);
+}
+
+Error Jit::call(Environment& env, OTBlock const& body) {
+	if (functions.size() >= sweep_at) sweep();
+	Function& f = functions[body.get_value()];
+	if (f.storage.expired()) {
+		// a new entry, or one left by a dead body at the same address (only counts, see sweep())
+		f.storage = body.storage();
+		f.calls = 0;
+		f.failed = false;
+	}
+	if (!f.code && !f.failed && ++f.calls >= HOT_CALLS) {
+		f.body = body;
+		f.code = compile(f, true);
+		f.speculative = f.code != nullptr;
+		f.failed = f.code == nullptr;
+		if (f.failed) {
+			// the interpreter runs it, like a body that is not hot
+			f.body.reset();
+			f.exits.clear();
+			f.sites.clear();
+		}
+	}
+	if (!f.code) return resume_block(env, *(const Block*)body.get_value(), 0);
+	return run(env, f);
+}
+
+Error Jit::call(Environment& env, CallSite& site) {
+	Dictionary const& words = env.defined_words;
+	if (site.words == &words && site.revision == words.revision()) return run(env, *site.callee);
+	const OTBlock* defined = words.find(*site.name);
+	if (!defined) return UNDEFINED_WORD;
+	// keep the body alive, even if the word is redefined while it runs
+	OTBlock body = *defined;
+	auto it = functions.find(body.get_value());
+	if (it == functions.end() || !it->second.code) return call(env, body);
+	// the compiled body is kept alive by the function
+	site = CallSite{site.name, &words, words.revision(), &it->second};
+	return run(env, it->second);
+}
+
+Error Jit::run(Environment& env, Function& f) {
+	f.running++;
+	Error e = run_code(env, f);
+	f.running--;
+	return e;
+}
+
+Error Jit::run_code(Environment& env, Function& f) {
+	Error e;
+	const Exit* exit = f.code(&env, &e);
+	if (!exit) return SUCCESS;
+	if (e != SUCCESS) {
+		for (const std::string* word: exit->words)
+			env.out << "Running word " << *word << "\n";
+		return e;
+	}
+	if (++f.deopts >= DEOPT_LIMIT && f.speculative) {
+		Native code = compile(f, false);
+		if (code) f.code = code;
+		f.speculative = false;
+	}
+	return resume_block(env, *(const Block*)f.body->get_value(), exit->resume);
+}
+
+void Jit::sweep(void) {
+	std::vector<const Function*> dead;
+	for (auto it = functions.begin(); it != functions.end();) {
+		Function& f = it->second;
+		// a compiled body is dead when no block shares it any more: the word was redefined, or the block is gone
+		if (f.body ? f.running > 0 || f.body->use_count() > 1 : !f.storage.expired()) {
+			++it;
+			continue;
+		}
+		for (const uint8_t* code: f.installed) release(code);
+		dead.push_back(&f);
+		it = functions.erase(it);
+	}
+	// a call site of a dead body is stale anyway (its word was redefined), but the dictionary may be new at the same address
+	if (!dead.empty()) {
+		std::sort(dead.begin(), dead.end());
+		for (auto& entry: functions) {
+			for (CallSite& site: entry.second.sites) {
+				if (std::binary_search(dead.begin(), dead.end(), site.callee))
+					site = CallSite{site.name};
+			}
+		}
+	}
+	sweep_at = std::max(SWEEP_MIN, functions.size() * 2);
+}
+
+/// A futtatható memória foglalási egysége.
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+/// A kódok kezdőcímének igazítása.
+static constexpr size_t CODE_ALIGNMENT = 16;
+
+const uint8_t* Jit::install(std::vector<uint8_t> const& code) {
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	if (chunks.empty() || chunks.back().size - chunks.back().used < code.size()) {
+		size_t size = std::max(CHUNK_SIZE, (code.size() + page - 1) / page * page);
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) return nullptr;
+		chunks.push_back(Chunk{(uint8_t*)p, size, 0, 0});
+	}
+	// never writable and executable at the same time; only the pages of the new code change,
+	// the rest of the chunk holds older code or is not used yet
+	Chunk& c = chunks.back();
+	uint8_t* at = c.base + c.used;
+	uint8_t* first = c.base + c.used / page * page;
+	size_t length = (at + code.size() - first + page - 1) / page * page;
+	if (mprotect(first, length, PROT_READ | PROT_WRITE) != 0) return nullptr;
+	memcpy(at, code.data(), code.size());
+	c.used = std::min(c.size, (c.used + code.size() + CODE_ALIGNMENT - 1) / CODE_ALIGNMENT * CODE_ALIGNMENT);
+	if (mprotect(first, length, PROT_READ | PROT_EXEC) != 0) return nullptr;
+	c.live++;
+	return at;
+}
+
+void Jit::release(const uint8_t* code) {
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		if (code < it->base || code >= it->base + it->size) continue;
+		if (--it->live == 0) {
+			munmap(it->base, it->size);
+			chunks.erase(it);
+		}
+		return;
+	}
+}
+
+#ifdef STACC_JIT
+
+/// A gyors változat nem tudta végrehajtani a szót, a verem változatlan.
+static constexpr int DEOPT = -1;
+
+/// Egész literál a verembe.
+static void push_int(Environment* env, int64_t v) {
+	env->stack.push_back(new OTInt(v));
+}
+
+/// Literál másolata a verembe.
+static void push_literal(Environment* env, const Object* o) {
+	env->stack.push_back(o->clone());
+}
+
+/// Szó definiálása (<tt>'name</tt>), mint az interpreterben.
+static Error define_word(Environment* env, const std::string* name) {
+	if (env->stack.size() < 1) return STACK_UNDERFLOW;
+	Object* o = env->stack.back();
+	env->stack.pop_back();
+	if (o->type() != Object::Block) {
+		delete o;
+		return TYPE_MISMATCH;
+	}
+	env->defined_words.define(name->substr(1), *(const Block*)o->get_value());
+	delete o;
+	return SUCCESS;
+}
+
+/// Definiált szó hívása.
+static Error call_word(Environment* env, Jit::CallSite* site) {
+	return env->jit->call(*env, *site);
+}
+
+/// Kétoperandusú művelet két egészre: az alsó operandust helyben írja felül.
+/// @returns \c DEOPT, ha az operandusok nem egészek, vagy a művelet nem értelmezett rájuk.
+template<typename Op> static int int_binary(Environment* env) {
+	Stack& s = env->stack;
+	size_t n = s.size();
+	if (n < 2) return DEOPT;
+	Object* top = s[n - 1];
+	Object* bottom = s[n - 2];
+	if (top->type() != Object::Int || bottom->type() != Object::Int) return DEOPT;
+	auto result = Op()(Repr<Object::Int>::get(bottom), Repr<Object::Int>::get(top));
+	int64_t& out = *(int64_t*)bottom->get_value();
+	if constexpr (std::is_same_v<decltype(result), std::optional<int64_t>>) {
+		if (!result) return DEOPT;
+		out = *result;
+	} else {
+		out = (int64_t)result;
+	}
+	s.pop_back();
+	delete top;
+	return SUCCESS;
+}
+
+/// \c inc és \c dec egészre, helyben.
+template<int64_t D> static int int_step(Environment* env) {
+	Stack& s = env->stack;
+	if (s.empty() || s.back()->type() != Object::Int) return DEOPT;
+	*(int64_t*)s.back()->get_value() += D;
+	return SUCCESS;
+}
+
+/// Az \c if feltételének levétele.
+/// @returns 1 vagy 0, illetve \c DEOPT, ha a verem tetején nincs egész.
+static int condition(Environment* env) {
+	Stack& s = env->stack;
+	if (s.empty() || s.back()->type() != Object::Int) return DEOPT;
+	Object* o = s.back();
+	s.pop_back();
+	int taken = *(const int64_t*)o->get_value() != 0;
+	delete o;
+	return taken;
+}
+
+/// Egész operandusokra gyorsan futtatható beépített szó.
+struct FastWord {
+	std::string_view name;
+	int (*fn)(Environment*);
+};
+
+static constexpr FastWord fast_words[] = {
+	{"+", int_binary<Add>}, {"-", int_binary<Sub>}, {"*", int_binary<Mul>},
+	{"/", int_binary<Div>}, {"%", int_binary<Mod>},
+	{"min", int_binary<Min>}, {"max", int_binary<Max>},
+	{"<", int_binary<Less>}, {">", int_binary<Greater>},
+	{"<=", int_binary<LessEqual>}, {">=", int_binary<GreaterEqual>},
+	{"=", int_binary<Equal>}, {"!=", int_binary<NotEqual>},
+	{"and", int_binary<BitAnd>}, {"or", int_binary<BitOr>}, {"xor", int_binary<BitXor>},
+	{"inc", int_step<1>}, {"dec", int_step<-1>},
+};
+
+static int (*find_fast(std::string_view name))(Environment*) {
+	for (FastWord const& w: fast_words)
+		if (w.name == name) return w.fn;
+	return nullptr;
+}
+
+/// Gépi kód összeállítása (x86-64).
+class Assembler {
+	std::vector<uint8_t> bytes;
+public:
+	std::vector<uint8_t> const& code(void) const { return bytes; }
+	size_t here(void) const { return bytes.size(); }
+
+	void emit(std::initializer_list<uint8_t> b) { bytes.insert(bytes.end(), b); }
+	void imm32(uint32_t v) { for (int i = 0; i < 4; i++) bytes.push_back((uint8_t)(v >> (8 * i))); }
+	void imm64(uint64_t v) { for (int i = 0; i < 8; i++) bytes.push_back((uint8_t)(v >> (8 * i))); }
+
+	/// Ugrás (\c jmp vagy \c jcc rel32) még ismeretlen célra.
+	/// @returns A cél helye, lásd bind().
+	size_t jump(std::initializer_list<uint8_t> opcode) {
+		emit(opcode);
+		imm32(0);
+		return here() - 4;
+	}
+	/// Az ugrás célja (alapból az aktuális hely).
+	void bind(size_t at, size_t target) {
+		uint32_t rel = (uint32_t)(int32_t)(target - (at + 4));
+		memcpy(&bytes[at], &rel, 4);
+	}
+	void bind(size_t at) { bind(at, here()); }
+
+	/// <tt>fn(env)</tt> hívása.
+	template<typename F> void call(F* fn) {
+		emit({0x48, 0x89, 0xdf});					// mov rdi, rbx
+		emit({0x48, 0xb8}); imm64(reinterpret_cast<uintptr_t>(fn));	// mov rax, fn
+		emit({0xff, 0xd0});						// call rax
+	}
+	/// <tt>fn(env, arg)</tt> hívása.
+	template<typename F> void call(F* fn, uint64_t arg) {
+		emit({0x48, 0xbe}); imm64(arg);					// mov rsi, arg
+		call(fn);
+	}
+
+	void prologue(void) {
+		emit({0x53});							// push rbx
+		emit({0x41, 0x54});						// push r12
+		emit({0x48, 0x83, 0xec, 0x08});					// sub rsp, 8 (alignment)
+		emit({0x48, 0x89, 0xfb});					// mov rbx, rdi
+		emit({0x49, 0x89, 0xf4});					// mov r12, rsi
+	}
+	void epilogue(void) {
+		emit({0x48, 0x83, 0xc4, 0x08});					// add rsp, 8
+		emit({0x41, 0x5c});						// pop r12
+		emit({0x5b});							// pop rbx
+		emit({0xc3});							// ret
+	}
+};
+
+/// @{
+/// Feltételes ugrások a visszatérési érték (\c eax) vizsgálata után.
+static constexpr std::initializer_list<uint8_t> JUMP_IF_NONZERO = {0x0f, 0x85};
+static constexpr std::initializer_list<uint8_t> JUMP_IF_ZERO = {0x0f, 0x84};
+static constexpr std::initializer_list<uint8_t> JUMP_IF_NEGATIVE = {0x0f, 0x88};
+static constexpr std::initializer_list<uint8_t> JUMP = {0xe9};
+/// @}
+
+/// Az \c if -ek beillesztésének legnagyobb mélysége.
+static constexpr size_t MAX_INLINE_DEPTH = 8;
+
+/// Egy törzs fordítása.
+class Compiler {
+	Assembler a;
+	std::deque<Jit::Exit>& exits;
+	std::deque<Jit::CallSite>& sites;
+	/// Még meg nem írt kilépések: az ugrás helye és a kilépési pont.
+	std::vector<std::pair<size_t, const Jit::Exit*>> pending;
+	bool speculate;
+
+	/// A hívott függvény hibája esetén kilépés.
+	void exit_on_error(std::vector<const std::string*> words) {
+		a.emit({0x85, 0xc0});						// test eax, eax
+		exit_on(JUMP_IF_NONZERO, 0, std::move(words));
+	}
+
+	void exit_on(std::initializer_list<uint8_t> jump, size_t resume, std::vector<const std::string*> words) {
+		exits.push_back(Jit::Exit{resume, std::move(words)});
+		pending.emplace_back(a.jump(jump), &exits.back());
+	}
+
+	/// A hibát okozó szó, a beillesztett szavak, amelyekből származik (lásd OTWord::inlined), és a külső szavak.
+	static std::vector<const std::string*> with(const Object* word, std::vector<const std::string*> const& outer) {
+		std::vector<const std::string*> words{(const std::string*)word->get_value()};
+		if (((const OTWord*)word)->inlined)
+			for (std::string const& name: *((const OTWord*)word)->inlined) words.push_back(&name);
+		words.insert(words.end(), outer.begin(), outer.end());
+		return words;
+	}
+
+	static bool is_word(const Object* o, std::string_view name) {
+		return o->type() == Object::Word && *(const std::string*)o->get_value() == name;
+	}
+
+	/// Blokk elemeinek fordítása.
+	/**
+	 * @param outer A blokkot futtató szavak (beillesztett \c if -ek), a legbelsővel kezdve.
+	 * @param top A törzs legfelső szintje-e: csak innen lehet visszalépni.
+	 */
+	void block(Block const& code, std::vector<const std::string*> const& outer, bool top) {
+		for (size_t i = 0; i < code.size(); i++) {
+			const Object* o = code[i];
+			if (i + 2 < code.size() && outer.size() < MAX_INLINE_DEPTH && is_word(code[i + 2], "if")
+				&& o->type() == Object::Block && code[i + 1]->type() == Object::Block) {
+				branch(code, i, outer, top);
+				i += 2;
+				continue;
+			}
+			if (o->type() == Object::Int) {
+				a.call(push_int, (uint64_t)*(const int64_t*)o->get_value());
+				continue;
+			}
+			if (o->type() != Object::Word) {
+				a.call(push_literal, reinterpret_cast<uintptr_t>(o));
+				continue;
+			}
+
+			std::string const& name = *(const std::string*)o->get_value();
+			if (name.front() == '\'') {
+				a.call(define_word, reinterpret_cast<uintptr_t>(&name));
+				exit_on_error(outer);
+				continue;
+			}
+
+			Word fn = find_builtin(name);
+			if (!fn) {
+				sites.push_back(Jit::CallSite{&name});
+				a.call(call_word, reinterpret_cast<uintptr_t>(&sites.back()));
+				exit_on_error(with(o, outer));
+				continue;
+			}
+			int (*fast)(Environment*) = find_fast(name);
+			if (fast && top && speculate) {
+				a.call(fast);
+				a.emit({0x85, 0xc0});					// test eax, eax
+				exit_on(JUMP_IF_NONZERO, i, {});
+			} else if (fast) {
+				a.call(fast);
+				a.emit({0x85, 0xc0});					// test eax, eax
+				size_t done = a.jump(JUMP_IF_ZERO);
+				a.call(fn);
+				exit_on_error(with(o, outer));
+				a.bind(done);
+			} else {
+				a.call(fn);
+				exit_on_error(with(o, outer));
+			}
+		}
+	}
+
+	/// <tt>[ ... ] [ ... ] if</tt> fordítása: a feltétel után a két ág a helyén.
+	/// @param i Az első blokk indexe.
+	void branch(Block const& code, size_t i, std::vector<const std::string*> const& outer, bool top) {
+		std::vector<const std::string*> inner = with(code[i + 2], outer);
+
+		a.call(condition);
+		a.emit({0x85, 0xc0});						// test eax, eax
+		size_t fallback = 0;
+		if (top && speculate) exit_on(JUMP_IF_NEGATIVE, i, {});
+		else fallback = a.jump(JUMP_IF_NEGATIVE);
+		size_t if_false = a.jump(JUMP_IF_ZERO);
+		block(*(const Block*)code[i]->get_value(), inner, false);
+		size_t end = a.jump(JUMP);
+		a.bind(if_false);
+		block(*(const Block*)code[i + 1]->get_value(), inner, false);
+		if (!(top && speculate)) {
+			// not an int on top: the builtin reports the error
+			size_t end2 = a.jump(JUMP);
+			a.bind(fallback);
+			a.call(push_literal, reinterpret_cast<uintptr_t>(code[i]));
+			a.call(push_literal, reinterpret_cast<uintptr_t>(code[i + 1]));
+			a.call(find_builtin("if"));
+			exit_on_error(inner);
+			a.bind(end2);
+		}
+		a.bind(end);
+	}
+
+public:
+	Compiler(Jit::Function& f, bool speculate): exits(f.exits), sites(f.sites), speculate(speculate) {}
+
+	std::vector<uint8_t> const& compile(Block const& code) {
+		a.prologue();
+		block(code, {}, true);
+		a.emit({0x31, 0xc0});						// xor eax, eax
+		a.epilogue();
+
+		// the common part of the exits: the error (deoptimization is success) and the exit point
+		size_t common = a.here();
+		a.emit({0x3d}); a.imm32((uint32_t)DEOPT);			// cmp eax, DEOPT
+		a.emit({0x75, 0x02});						// jne +2
+		a.emit({0x31, 0xc0});						// xor eax, eax
+		a.emit({0x41, 0x89, 0x04, 0x24});				// mov [r12], eax
+		a.emit({0x48, 0x89, 0xc8});					// mov rax, rcx
+		a.epilogue();
+
+		for (auto const& [at, exit]: pending) {
+			a.bind(at);
+			a.emit({0x48, 0xb9}); a.imm64(reinterpret_cast<uintptr_t>(exit));	// mov rcx, exit
+			a.bind(a.jump(JUMP), common);
+		}
+		return a.code();
+	}
+};
+
+Jit::Native Jit::compile(Function& f, bool speculate) {
+	Compiler compiler(f, speculate);
+	const uint8_t* code = install(compiler.compile(*(const Block*)f.body->get_value()));
+	if (code) f.installed.push_back(code);
+	return code ? reinterpret_cast<Native>(reinterpret_cast<uintptr_t>(code)) : nullptr;
+}
+
+#else
+
+Jit::Native Jit::compile(Function&, bool) {
+	return nullptr;
+}
+
+#endif
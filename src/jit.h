@@ -0,0 +1,155 @@
+/**
+ * @file
+ * @brief Gyakran hívott szavak fordítása gépi kódra (JIT, \c --no-jit kikapcsolja).
+ *
+ * A definiált szavak törzsét és a futtatott blokkokat (pl. egy \c times
+ * törzsét) először az interpreter futtatja, és számolja a hívásokat. Ha egy törzs elég sokszor futott, gépi kódra fordítja: minden
+ * elemből egy előre megírt kódminta lesz, amibe csak a címeket kell beírni
+ * (literál a verembe, beépített szó függvényének hívása, definiált szó
+ * hívása). Így elmarad a szavak név szerinti keresése és a típus szerinti
+ * elágazás. Az \c if két literál blokkját a helyére fordítja.
+ *
+ * A gyakori egész műveletekre (pl. \c +, \c <) feltételezi, hogy a két
+ * operandus egész, és a verem elemét helyben írja felül. Ha a feltételezés nem
+ * teljesül, a kód visszalép (deoptimalizál): a verem változatlan, és az
+ * interpreter folytatja a törzset attól az elemtől. Ha egy törzs túl sokszor
+ * lép vissza, feltételezés nélkül fordítja újra (a gyors ág után a beépített
+ * szót hívja). Egy szó újradefiniálásakor új törzs készül, így a régi kódja
+ * többé nem fut. Ha egy törzset már csak a fordító tart életben (a szót
+ * újradefiniálták, vagy a blokk törlődött), időnként a kódjával együtt törli.
+ *
+ * Csak x86-64 (System V) rendszeren fordít, máshol minden az interpreterben fut.
+ */
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "interpreter.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+/// A JIT elérhető ezen a rendszeren.
+#define STACC_JIT 1
+#endif
+
+/// Gyakran hívott szavak fordítója; szálanként (feladatonként) egy kell.
+class Jit {
+public:
+	/// Ennyi hívás után fordítja le a törzset.
+	static constexpr size_t HOT_CALLS = 64;
+	/// Ennyi visszalépés után fordítja újra feltételezések nélkül.
+	static constexpr size_t DEOPT_LIMIT = 16;
+
+	/// A lefordított kód egy kilépési pontja.
+	struct Exit {
+		/// Visszalépésnél ettől az elemtől folytatja az interpreter a törzset.
+		size_t resume;
+		/// Hibánál a hibát okozó szavak, a legbelsővel kezdve (a hibaüzenethez).
+		std::vector<const std::string*> words;
+	};
+
+	/// Lefordított törzs.
+	/**
+	 * @param env A futtatás környezete.
+	 * @param[out] error A hiba, visszalépésnél \c SUCCESS (csak ha a kód nem futott végig).
+	 * @returns \c nullptr, ha végigfutott, különben a kilépési pont.
+	 */
+	using Native = const Exit* (*)(Environment* env, Error* error);
+
+	/// Egy törzs állapota.
+	struct Function;
+
+	/// Definiált szó hívása a lefordított kódban.
+	/**
+	 * Megjegyzi, melyik törzs futott, és amíg a szótár nem változik, a
+	 * következő hívás keresés nélkül a kódját futtatja.
+	 */
+	struct CallSite {
+		const std::string* name;
+		const Dictionary* words = nullptr;
+		size_t revision = 0;
+		Function* callee = nullptr;
+	};
+
+	struct Function {
+		/// A törzs tárolója; ha lejárt, a bejegyzés egy azóta törölt törzsé volt ugyanezen a címen.
+		std::weak_ptr<const void> storage;
+		size_t calls = 0;
+		size_t deopts = 0;
+		Native code = nullptr;
+		/// A kód feltételezi-e az operandusok típusát.
+		bool speculative = false;
+		/// Nem sikerült lefordítani, mindig az interpreter futtatja.
+		bool failed = false;
+		/// A fordított törzs, a kód a literáljaira és a szavak neveire hivatkozik.
+		std::optional<OTBlock> body;
+		/// A kilépési pontok és a szóhívások; egy újrafordítás után is megmaradnak, a régi kód még futhat.
+		std::deque<Exit> exits;
+		std::deque<CallSite> sites;
+		/// A lefordított kódok helye, az újrafordítás előtti is.
+		std::vector<const uint8_t*> installed;
+		/// A folyamatban lévő futásai száma, közben nem törölhető.
+		size_t running = 0;
+	};
+
+	Jit(void) = default;
+	Jit(Jit const&) = delete;
+	Jit& operator=(Jit const&) = delete;
+	~Jit(void);
+
+	/// Definiált szó törzsének futtatása.
+	/**
+	 * Számolja a törzs hívásait, és ha elég sokszor futott, lefordítja. A
+	 * lefordított törzs kódját futtatja, ha az visszalép, az interpreter
+	 * folytatja, különben az interpreter futtatja a törzset.
+	 * @param env A futtatás környezete.
+	 * @param body A szó törzse, a hívó tartja életben.
+	 */
+	Error call(Environment& env, OTBlock const& body);
+
+	/// Definiált szó hívása a lefordított kódból.
+	Error call(Environment& env, CallSite& site);
+
+private:
+	/// Futtatható memória, a kódok egymás után kerülnek bele.
+	struct Chunk {
+		uint8_t* base;
+		size_t size;
+		size_t used;
+		/// A benne lévő, még használt kódok száma.
+		size_t live;
+	};
+
+	/// Legalább ennyi törzs esetén törli a feleslegeseket.
+	static constexpr size_t SWEEP_MIN = 256;
+
+	/// A törzsek a tárolójuk címe szerint.
+	std::unordered_map<const void*, Function> functions;
+	std::vector<Chunk> chunks;
+	/// Ennyi törzs esetén törli legközelebb a feleslegeseket.
+	size_t sweep_at = SWEEP_MIN;
+
+	/// Lefordított törzs futtatása.
+	Error run(Environment& env, Function& f);
+	/// Mint run(), a futás számolása nélkül.
+	Error run_code(Environment& env, Function& f);
+	/// A már csak a fordító által életben tartott törzsek és kódjuk törlése.
+	void sweep(void);
+	/// Törzs fordítása.
+	/// @returns A kód, vagy \c nullptr, ha nem sikerült.
+	Native compile(Function& f, bool speculate);
+	/// Gépi kód bemásolása futtatható memóriába.
+	/// @returns A kód helye, vagy \c nullptr, ha nem kapott futtatható memóriát.
+	const uint8_t* install(std::vector<uint8_t> const& code);
+	/// Egy install() -lal bemásolt kód felszabadítása; az üressé vált futtatható memóriát visszaadja.
+	void release(const uint8_t* code);
+};
+
+#endif
@@ -1,53 +1,37 @@
 /**
  * @file
  * @brief Wrapper a többi funkcionalitás körül.
- * @todo REPL mód
  * @todo Tesztek
  */
 #include <iostream>
-#include <fstream> 
+#include <fstream>
+#include <sstream>
 #include <cstring>
 #include <cerrno>
+#include <cstdlib>
+#include <string>
 #include <optional>
 #include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
 
 #include "tokenizer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "io.h"
+#include "server.h"
+#include "trace.h"
+#include "counters.h"
+#include "sampler.h"
+#include "tasks.h"
+#include "jit.h"
 
 #define ERROR "[\x1b[91mERROR\x1b[m] "
 
-int main(int argc, char** argv) {
-
-	if (argc < 2) {
-		std::cout << ERROR "REPL mode not yet implemented\n";
-		return 1;
-	}
-
-	std::ifstream f{argv[1]};
-	if (!f.is_open()) {
-		std::cout << ERROR "File '" << argv[1] << "' could not be opened: " << strerror(errno) << "\n";
-		return 1;
-	}
-
-
-	std::optional<std::vector<Token*>> m_tokens = tokenize(f);
-	if (!m_tokens) {
-		std::cout << ERROR "Tokenization failed\n";
-		return 1;
-	}
-	std::vector<Token*> tokens = m_tokens.value();
-
-	/// @todo \c parse() rendberakása
-	std::vector<Token*>::const_iterator begin = tokens.cbegin();
-	std::optional<std::vector<Object*>> m_parsed = parse(begin, tokens.cend());
-
-	if (!m_parsed) {
-		std::cout << ERROR "Parsing failed\n";
-		return 1;
-	}
-	std::vector<Object*> parsed = m_parsed.value();
-	Error e = interpret(parsed);
+/// Futási hiba kiírása.
+static void report(Error e) {
 	/// @todo Hiba helyének megjelölése
 	switch (e) {
 		case SUCCESS: break;
@@ -71,7 +55,68 @@ int main(int argc, char** argv) {
 			/// @todo Milyen értéket vártunk (valami szövegként összefoglalva)
 			std::cout << ERROR "Incorrect value.\n";
 			break;
+		case IO_ERROR:
+			/// @todo Melyik fájl, milyen hiba
+			std::cout << ERROR "File could not be read or written.\n";
+			break;
+		case TIMEOUT:
+			std::cout << ERROR "Time limit exceeded.\n";
+			break;
+		case OUT_OF_MEMORY:
+			std::cout << ERROR "Memory limit exceeded.\n";
+			break;
+		case SYNTAX_ERROR:
+			std::cout << ERROR "Tokenization or parsing failed.\n";
+			break;
+	}
+}
+
+/// Forrásfájl beolvasása, elemzése és futtatása.
+/**
+ * @param path A fájl elérési útja.
+ * @param env A futtatás környezete.
+ * @param frontend_threads Ennyi szálon tokenizál és elemez.
+ * @returns A futás eredménye, vagy \c std::nullopt, ha a fájlt nem sikerült
+ * 			megnyitni vagy elemezni (ezt már ki is írta).
+ */
+static std::optional<Error> run_file(const char* path, Environment& env, unsigned frontend_threads) {
+	std::optional<std::vector<Token*>> m_tokens;
+	if (frontend_threads > 1) {
+		std::shared_ptr<MappedBuffer> source = MappedBuffer::open(path);
+		if (!source) {
+			std::cout << ERROR "File '" << path << "' could not be opened: " << strerror(errno) << "\n";
+			return std::nullopt;
+		}
+		m_tokens = tokenize_parallel(std::string_view((const char*)source->data(), source->size()), frontend_threads, path);
+	} else {
+		std::ifstream f{path};
+		if (!f.is_open()) {
+			std::cout << ERROR "File '" << path << "' could not be opened: " << strerror(errno) << "\n";
+			return std::nullopt;
+		}
+		m_tokens = tokenize(f, path);
 	}
+	if (!m_tokens) {
+		std::cout << ERROR "Tokenization failed\n";
+		return std::nullopt;
+	}
+	std::vector<Token*> tokens = m_tokens.value();
+
+	std::optional<std::vector<Object*>> m_parsed;
+	if (frontend_threads > 1) {
+		m_parsed = parse_parallel(tokens, frontend_threads);
+	} else {
+		/// @todo \c parse() rendberakása
+		std::vector<Token*>::const_iterator begin = tokens.cbegin();
+		m_parsed = parse(begin, tokens.cend());
+	}
+
+	if (!m_parsed) {
+		std::cout << ERROR "Parsing failed\n";
+		return std::nullopt;
+	}
+	std::vector<Object*> parsed = m_parsed.value();
+	Error e = interpret(parsed, env);
 
 	for (Object* o: parsed)
 		delete o;
@@ -79,6 +124,281 @@ int main(int argc, char** argv) {
 	for (Token* t: tokens)
 		delete t;
 
-	return 0;
+	return e;
+}
+
+/// Az interaktív módban beírt kód "fájlneve" a tokenek helyében.
+static const char* const REPL_SOURCE = "<stdin>";
+
+/// Interaktív mód: a standard bemenet sorainak futtatása ugyanabban a környezetben.
+/**
+ * Minden sort egyszer tokenizál és elemez, a korábbi sorokat nem: a szavaik
+ * (lefordítva) a szótárban, az értékeik a veremben maradnak. Ha egy sor végén
+ * nyitva marad egy szöveg, blokk vagy lista, a következő sorokkal együtt
+ * futtatja. Hiba után is ugyanazzal a veremmel és szótárral folytatja.
+ * @param env A futtatás környezete.
+ */
+static void run_repl(Environment& env) {
+	bool interactive = isatty(STDIN_FILENO);
+	// the lines of an unterminated string, they are tokenized together
+	std::string partial;
+	uint32_t line_number = 0, partial_line = 0;
+	// the tokens of an unfinished block or list, and its nesting depth
+	std::vector<Token*> tokens;
+	int64_t depth = 0;
+	auto discard = [&](void) {
+		for (Token* t: tokens)
+			delete t;
+		tokens.clear();
+		depth = 0;
+	};
+
+	std::string line;
+	for (;;) {
+		if (interactive) std::cout << (tokens.empty() && partial.empty() ? "> " : ". ") << std::flush;
+		if (!std::getline(std::cin, line)) break;
+		if (partial.empty()) partial_line = line_number + 1;
+		line_number++;
+		partial += line;
+		partial += '\n';
+		if (ends_in_string(partial)) continue;
+
+		std::optional<std::vector<Token*>> m_tokens = tokenize(std::string_view(partial), REPL_SOURCE, partial_line);
+		partial.clear();
+		if (!m_tokens) {
+			std::cout << ERROR "Tokenization failed\n";
+			discard();
+			continue;
+		}
+		for (Token* t: *m_tokens) {
+			if (t->type() == Token::Word) {
+				std::string const& w = *(std::string*)t->get_value();
+				if (w == "[" || w == "{") depth++;
+				else if (w == "]" || w == "}") depth--;
+			}
+			tokens.push_back(t);
+		}
+		if (depth > 0) continue;
+
+		std::optional<std::vector<Object*>> parsed;
+		if (depth == 0) {
+			std::vector<Token*>::const_iterator begin = tokens.cbegin();
+			parsed = parse(begin, tokens.cend());
+		}
+		discard();
+		if (!parsed) {
+			std::cout << ERROR "Parsing failed\n";
+			continue;
+		}
+		report(interpret(*parsed, env));
+		for (Object* o: *parsed)
+			delete o;
+	}
+	discard();
+	if (interactive) std::cout << "\n";
+}
+
+/// Számértékű kapcsoló (pl. \c --workers=4) értékének beolvasása.
+/// @param separator Az érték előtti karakter első előfordulása után olvas.
+/// @returns Hamis, ha az érték nem nemnegatív egész.
+static bool numeric_option(const char* arg, size_t& out, char separator = '=') {
+	const char* n = strchr(arg, separator) + 1;
+	char* end;
+	out = strtoull(n, &end, 10);
+	return *n != '\0' && *end == '\0' && *n != '-';
 }
 
+int main(int argc, char** argv) {
+
+	Options options;
+	const char* path = nullptr;
+	const char* serve_path = nullptr;
+	const char* connect_path = nullptr;
+	const char* prelude_path = nullptr;
+	const char* decode_path = nullptr;
+	const char* trace_path = "stacc.trace";
+	const char* sample_path = "stacc.folded";
+	bool chrome = false, counters = false, jit = true;
+	size_t frontend_threads = 1, workers = 0, time_limit = 0, memory_limit = 0, trace_size = 0, sample_rate = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		size_t* number = nullptr;
+		const char** next = nullptr;
+		if (arg.rfind("--inline-threshold=", 0) == 0)
+			number = &options.inline_threshold;
+		else if (arg.rfind("--frontend-threads=", 0) == 0)
+			number = &frontend_threads;
+		else if (arg.rfind("--workers=", 0) == 0)
+			number = &workers;
+		else if (arg.rfind("--time-limit=", 0) == 0)
+			number = &time_limit;
+		else if (arg.rfind("--memory-limit=", 0) == 0)
+			number = &memory_limit;
+		else if (arg == "--serve")
+			next = &serve_path;
+		else if (arg == "--connect")
+			next = &connect_path;
+		else if (arg == "--prelude")
+			next = &prelude_path;
+		else if (arg.rfind("--trace=", 0) == 0) {
+			// the only kind of trace for now: `ring:N`, the last N words
+			bool ring = arg.rfind("--trace=ring:", 0) == 0;
+			if (!ring || !numeric_option(argv[i], trace_size, ':') || trace_size == 0) {
+				std::cout << ERROR "Invalid value '" << arg.substr(strlen("--trace=")) << "' for option '--trace', expected 'ring:N'\n";
+				return 1;
+			}
+		} else if (arg.rfind("--trace-output=", 0) == 0)
+			trace_path = argv[i] + strlen("--trace-output=");
+		else if (arg.rfind("--sample=", 0) == 0)
+			number = &sample_rate;
+		else if (arg.rfind("--sample-output=", 0) == 0)
+			sample_path = argv[i] + strlen("--sample-output=");
+		else if (arg == "--decode-trace")
+			next = &decode_path;
+		else if (arg == "--chrome")
+			chrome = true;
+		else if (arg == "--counters")
+			counters = true;
+		else if (arg == "--no-jit")
+			jit = false;
+		else if (arg.rfind("--", 0) == 0) {
+			std::cout << ERROR "Unknown option '" << arg << "'\n";
+			return 1;
+		} else {
+			path = argv[i];
+		}
+
+		if (number && !numeric_option(argv[i], *number)) {
+			std::cout << ERROR "Invalid value '" << strchr(argv[i], '=') + 1 << "' for option '" << arg.substr(0, arg.find('=')) << "'\n";
+			return 1;
+		}
+		if (next) {
+			if (i + 1 == argc) {
+				std::cout << ERROR "Missing value for option '" << arg << "'\n";
+				return 1;
+			}
+			*next = argv[++i];
+		}
+	}
+	if (frontend_threads == 0) frontend_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	if (decode_path) {
+		if (!decode_trace(decode_path, std::cout, chrome)) {
+			std::cout << ERROR "Trace '" << decode_path << "' could not be read\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	if (connect_path) {
+		if (!path) {
+			std::cout << ERROR "No program given to send\n";
+			return 1;
+		}
+		std::ifstream f{path};
+		if (!f.is_open()) {
+			std::cout << ERROR "File '" << path << "' could not be opened: " << strerror(errno) << "\n";
+			return 1;
+		}
+		std::stringstream source;
+		source << f.rdbuf();
+
+		RequestHeader header{0, time_limit * 1000, memory_limit};
+		std::string output;
+		Error e;
+		if (!run_remote(connect_path, source.str(), header, output, e)) {
+			std::cout << ERROR "Server '" << connect_path << "' could not be reached: " << strerror(errno) << "\n";
+			return 1;
+		}
+		std::cout << output;
+		report(e);
+		return 0;
+	}
+
+	// the instruments report every defined word, an inlined call would be attributed to its caller
+	if (!serve_path && (trace_size || counters || sample_rate)) options.inline_threshold = 0;
+
+	Stack stack;
+	Dictionary words(options.inline_threshold);
+	Environment env{stack, words};
+	Instruments instruments;
+	std::unique_ptr<Tracer> tracer;
+	if (trace_size && !serve_path) {
+		tracer = std::make_unique<Tracer>(trace_size, trace_path);
+		Tracer::dump_on_signal();
+		instruments.trace = tracer.get();
+	}
+	std::unique_ptr<Counters> counter;
+	if (counters && !serve_path) {
+		counter = std::make_unique<Counters>();
+		instruments.counters = counter.get();
+	}
+	std::unique_ptr<Sampler> sampler;
+	if (sample_rate && !serve_path) {
+		bool ok;
+		sampler = std::make_unique<Sampler>(sample_rate, sample_path, ok);
+		if (!ok) {
+			std::cout << ERROR "Sampling timer could not be started: " << strerror(errno) << "\n";
+			return 1;
+		}
+		instruments.sampler = sampler.get();
+	}
+
+	if (tracer || counter || sampler) env.instruments = &instruments;
+
+	// the instruments see every word, the compiled code would bypass them
+	std::unique_ptr<Jit> compiler;
+	if (jit && !env.instruments && !serve_path) {
+		compiler = std::make_unique<Jit>();
+		env.jit = compiler.get();
+	}
+
+	// shared definitions, the program starts with an empty stack
+	if (prelude_path) {
+		std::optional<Error> e = run_file(prelude_path, env, (unsigned)frontend_threads);
+		if (!e) return 1;
+		if (*e != SUCCESS) {
+			report(*e);
+			if (tracer) tracer->dump();
+			if (counter) counter->report(std::cerr);
+			if (sampler) sampler->write();
+			return 1;
+		}
+		for (Object* o: stack)
+			delete o;
+		stack.clear();
+	}
+
+	if (serve_path) {
+		if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+		if (!serve(serve_path, words, (unsigned)workers)) {
+			std::cout << ERROR "Socket '" << serve_path << "' could not be created: " << strerror(errno) << "\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	if (path) {
+		std::optional<Error> e = run_file(path, env, (unsigned)frontend_threads);
+		if (!e) return 1;
+		report(*e);
+	} else {
+		run_repl(env);
+	}
+	if (tracer && !tracer->dump())
+		std::cout << ERROR "Trace '" << trace_path << "' could not be written: " << strerror(errno) << "\n";
+	if (counter) counter->report(std::cerr);
+	if (sampler && !sampler->write())
+		std::cout << ERROR "Samples '" << sample_path << "' could not be written: " << strerror(errno) << "\n";
+
+	for (Object* o: stack)
+		delete o;
+
+	// like a process ending its main thread: tasks that were not joined are
+	// stopped, they may be waiting on a channel forever
+	if (tasks_running()) {
+		std::cout.flush();
+		std::_Exit(0);
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Szálankénti memóriakorlát implementáció.
+ */
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <malloc.h>
+
+#include "memory.h"
+#include "pool.h"
+
+static thread_local bool limited = false;
+static thread_local size_t limit_bytes = 0;
+/// A korlát beállítása óta lefoglalt és felszabadított bájtok különbsége.
+static thread_local int64_t used = 0;
+/// A pool foglalásai a korlát beállításakor (lásd pool_allocated()).
+static thread_local int64_t pool_base = 0;
+/// Túllépte-e a korlátot a beállítása óta.
+static thread_local bool exceeded = false;
+
+/// A korlát beállítása óta foglalt bájtok, a pool objektumaival együtt.
+static int64_t total_used(void) {
+	return used + pool_allocated() - pool_base;
+}
+
+void set_memory_limit(size_t limit) {
+	limited = limit != 0;
+	limit_bytes = limit;
+	used = 0;
+	pool_base = pool_allocated();
+	exceeded = false;
+}
+
+bool memory_exceeded(void) {
+	// pool allocations do not pass operator new
+	if (limited && total_used() > (int64_t)limit_bytes) exceeded = true;
+	return exceeded;
+}
+
+size_t memory_left(void) {
+	if (!limited) return SIZE_MAX;
+	int64_t total = total_used();
+	return total < (int64_t)limit_bytes ? limit_bytes - (size_t)total : 0;
+}
+
+void* operator new(size_t size) {
+	void* p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	if (limited) {
+		// the usable size is what operator delete can see, so both sides count the same
+		int64_t bytes = (int64_t)malloc_usable_size(p);
+		// the interpreter checks the flag and stops, throwing would leak the objects held by the running words
+		used += bytes;
+		if (total_used() > (int64_t)limit_bytes) exceeded = true;
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	if (limited && p) used -= (int64_t)malloc_usable_size(p);
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	operator delete(p);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file
+ * @brief Szálankénti memóriakorlát.
+ *
+ * A globális \c operator \c new és \c operator \c delete le van cserélve, hogy
+ * szálanként számolni tudják a lefoglalt memóriát. Korlát nélkül csak egy
+ * szál-lokális jelzőt néznek meg.
+ *
+ * A korlát túllépésekor az \c operator \c new nem dob kivételt (az
+ * interpreter nem kivételbiztos, a félbehagyott szavak objektumai elvesznének),
+ * csak megjegyzi a túllépést. Az interpreter minden szó előtt megnézi
+ * (Environment::memory_limit), és \c OUT_OF_MEMORY hibával áll le, a szavak a
+ * szokásos hibaágon szabadítják fel az objektumaikat. Egy szó tehát kissé
+ * túllépheti a korlátot; amelyek a meglévő adatoknál jóval többet foglalhatnak
+ * (pl. \c iota), előre vagy a ciklusukban ellenőrzik.
+ */
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+
+/// Memóriakorlát beállítása a hívó szálon.
+/**
+ * A beállítás után a szál legfeljebb \c limit bájttal foglalhat többet, mint
+ * amennyit felszabadít, e fölött memory_exceeded() igaz lesz.
+ * A pool allokátor (pool.h) objektumai is számítanak (a lapjai nem), így
+ * ugyanaz a program minden kérésben ugyanannyit foglal.
+ * @param limit A korlát bájtokban, 0 esetén nincs korlát.
+ */
+void set_memory_limit(size_t limit);
+
+/// Túllépte-e a szál a memóriakorlátot a beállítása óta.
+bool memory_exceeded(void);
+
+/// Ennyi bájtot foglalhat még a szál a korlát túllépése nélkül (korlát nélkül \c SIZE_MAX).
+size_t memory_left(void);
+
+#endif
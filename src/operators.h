@@ -0,0 +1,244 @@
+/**
+ * @file
+ * @brief Kétoperandusú beépített szavak (pl. \c +, \c <) típuspáronkénti kiválasztása.
+ *
+ * Egy műveletet egyszer kell megírni, függvényobjektumként, ami az operandusok
+ * C++ típusára (\c int64_t, \c double, \c std::string_view) van definiálva. A
+ * keretrendszer fordításkor készít belőle egy táblát, ami az operandusok
+ * típuspárjához (Object::Type) megadja a műveletet végző függvényt: a két
+ * operandust közös típusra hozza (egész és valós esetén valósra), meghívja a
+ * műveletet, és az eredményt objektumba csomagolja. Ha a művelet a típuspárra
+ * nincs definiálva, a táblában \c nullptr van.
+ */
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "parser.h"
+#include "interpreter.h"
+
+/// Az Object::Type értékek száma, a tábla mérete.
+constexpr size_t TYPE_COUNT = (size_t)Object::Channel + 1;
+
+/// Két operandusból eredményt számoló függvény.
+/**
+ * @param bottom Az alsó (előbb a verembe tett) operandus.
+ * @param top A felső operandus.
+ * @param[out] out Az eredmény, amelyet a hívó birtokol (csak siker esetén).
+ * @returns \c INCORRECT_VALUE, ha a művelet az értékekre nem értelmezett (pl. osztás nullával).
+ */
+using BinaryFn = Error (*)(const Object* bottom, const Object* top, Object*& out);
+
+/// Objektumtípus C++ megfelelője; csak az értékkel rendelkező típusokra van megadva.
+template<Object::Type T> struct Repr {};
+
+template<> struct Repr<Object::Int> {
+	using type = int64_t;
+	static int64_t get(const Object* o) { return *(const int64_t*)o->get_value(); }
+};
+
+template<> struct Repr<Object::Float> {
+	using type = double;
+	static double get(const Object* o) { return *(const double*)o->get_value(); }
+};
+
+template<> struct Repr<Object::String> {
+	using type = std::string_view;
+	static std::string_view get(const Object* o) { return ((const OTString*)o)->view(); }
+};
+
+/// Van-e az objektumtípusnak C++ megfelelője.
+template<Object::Type T, typename = void> struct HasRepr: std::false_type {};
+template<Object::Type T> struct HasRepr<T, std::void_t<typename Repr<T>::type>>: std::true_type {};
+
+/// A két operandus közös típusa: számoknál a bővebb, különben csak azonos típus, egyébként \c void.
+template<typename A, typename B, typename = void> struct Promote { using type = void; };
+template<typename A> struct Promote<A, A, void> { using type = A; };
+template<typename A, typename B>
+struct Promote<A, B, std::enable_if_t<!std::is_same_v<A, B> && std::is_arithmetic_v<A> && std::is_arithmetic_v<B>>> {
+	using type = std::common_type_t<A, B>;
+};
+
+/// @{
+/// Műveletek megszorításai: az \c R visszatérési típusú túlterhelés csak az adott \c T -re létezik.
+template<typename T, typename R = T> using IfNumber = std::enable_if_t<std::is_arithmetic_v<T>, R>;
+template<typename T, typename R = T> using IfInt = std::enable_if_t<std::is_integral_v<T>, R>;
+template<typename T, typename R = T> using IfFloat = std::enable_if_t<std::is_floating_point_v<T>, R>;
+template<typename T, typename R = T> using IfText = std::enable_if_t<std::is_same_v<T, std::string_view>, R>;
+/// @}
+
+/// @{
+/// Eredmény objektumba csomagolása.
+inline Error box(int64_t v, Object*& out) { out = new OTInt(v); return SUCCESS; }
+inline Error box(double v, Object*& out) { out = new OTFloat(v); return SUCCESS; }
+inline Error box(bool v, Object*& out) { out = new OTInt(v); return SUCCESS; }
+inline Error box(std::string&& v, Object*& out) { out = new OTString(std::move(v)); return SUCCESS; }
+inline Error box(std::string_view v, Object*& out) { out = new OTString(std::string(v)); return SUCCESS; }
+/// Üres eredmény: a művelet az értékekre nem értelmezett.
+template<typename R> Error box(std::optional<R>&& v, Object*& out) {
+	return v ? box(std::move(*v), out) : INCORRECT_VALUE;
+}
+/// @}
+
+/// A művelet egy típuspárra, fordításkor kiválasztott típusokkal.
+template<typename Op, Object::Type B, Object::Type T, typename P>
+static Error apply_binary(const Object* bottom, const Object* top, Object*& out) {
+	return box(Op()((P)Repr<B>::get(bottom), (P)Repr<T>::get(top)), out);
+}
+
+/// A tábla egy eleme: a függvény, vagy \c nullptr, ha a típuspárra nincs értelmezve.
+template<typename Op, Object::Type B, Object::Type T>
+constexpr BinaryFn binary_entry(void) {
+	if constexpr (HasRepr<B>::value && HasRepr<T>::value) {
+		using P = typename Promote<typename Repr<B>::type, typename Repr<T>::type>::type;
+		if constexpr (!std::is_void_v<P>) {
+			if constexpr (std::is_invocable_v<Op, P, P>)
+				return &apply_binary<Op, B, T, P>;
+		}
+	}
+	return nullptr;
+}
+
+template<typename Op, size_t B, size_t... T>
+constexpr std::array<BinaryFn, TYPE_COUNT> binary_row(std::index_sequence<T...>) {
+	return {{ binary_entry<Op, (Object::Type)B, (Object::Type)T>()... }};
+}
+
+template<typename Op, size_t... B>
+constexpr std::array<std::array<BinaryFn, TYPE_COUNT>, TYPE_COUNT> binary_table_of(std::index_sequence<B...>) {
+	return {{ binary_row<Op, B>(std::make_index_sequence<TYPE_COUNT>())... }};
+}
+
+/// A művelet táblája: <tt>binary_table<Op>[alsó típus][felső típus]</tt>.
+template<typename Op>
+inline constexpr std::array<std::array<BinaryFn, TYPE_COUNT>, TYPE_COUNT> binary_table =
+	binary_table_of<Op>(std::make_index_sequence<TYPE_COUNT>());
+
+/// Kétoperandusú beépített szó: <tt>a b -- a op b</tt>.
+/**
+ * Az operandusokat mindig leveszi a veremről, hiba esetén is.
+ * @tparam Op A művelet függvényobjektuma.
+ */
+template<typename Op> Error binary_word(Environment& env) {
+	if (env.stack.size() < 2) return STACK_UNDERFLOW;
+	Object* top = env.stack.back(); env.stack.pop_back();
+	Object* bottom = env.stack.back(); env.stack.pop_back();
+	BinaryFn fn = binary_table<Op>[bottom->type()][top->type()];
+	Object* result = nullptr;
+	Error e = fn ? fn(bottom, top, result) : TYPE_MISMATCH;
+	delete top; delete bottom;
+	if (e == SUCCESS) env.stack.push_back(result);
+	return e;
+}
+
+/// @name Műveletek
+/// @{
+
+/// Összeadás, illetve szövegek összefűzése.
+struct Add {
+	template<typename T> IfNumber<T> operator()(T a, T b) const { return a + b; }
+	template<typename T> IfText<T, std::string> operator()(T a, T b) const {
+		std::string r;
+		r.reserve(a.size() + b.size());
+		r.append(a); r.append(b);
+		return r;
+	}
+};
+
+struct Sub {
+	template<typename T> IfNumber<T> operator()(T a, T b) const { return a - b; }
+};
+
+struct Mul {
+	template<typename T> IfNumber<T> operator()(T a, T b) const { return a * b; }
+};
+
+/// Osztás, egészeknél nulla felé kerekítve.
+struct Div {
+	template<typename T> IfInt<T, std::optional<T>> operator()(T a, T b) const {
+		if (b == 0 || (a == std::numeric_limits<T>::min() && b == -1)) return std::nullopt;
+		return a / b;
+	}
+	template<typename T> IfFloat<T> operator()(T a, T b) const { return a / b; }
+};
+
+/// Maradék, az osztandó előjelével (mint C-ben).
+struct Mod {
+	template<typename T> IfInt<T, std::optional<T>> operator()(T a, T b) const {
+		if (b == 0 || (a == std::numeric_limits<T>::min() && b == -1)) return std::nullopt;
+		return a % b;
+	}
+	template<typename T> IfFloat<T> operator()(T a, T b) const { return std::fmod(a, b); }
+};
+
+struct Min {
+	template<typename T> T operator()(T a, T b) const { return b < a ? b : a; }
+};
+
+struct Max {
+	template<typename T> T operator()(T a, T b) const { return a < b ? b : a; }
+};
+
+struct Less {
+	template<typename T> bool operator()(T a, T b) const { return a < b; }
+};
+
+struct Greater {
+	template<typename T> bool operator()(T a, T b) const { return a > b; }
+};
+
+struct LessEqual {
+	template<typename T> bool operator()(T a, T b) const { return a <= b; }
+};
+
+struct GreaterEqual {
+	template<typename T> bool operator()(T a, T b) const { return a >= b; }
+};
+
+struct Equal {
+	template<typename T> bool operator()(T a, T b) const { return a == b; }
+};
+
+struct NotEqual {
+	template<typename T> bool operator()(T a, T b) const { return a != b; }
+};
+
+struct BitAnd {
+	template<typename T> IfInt<T> operator()(T a, T b) const { return a & b; }
+};
+
+struct BitOr {
+	template<typename T> IfInt<T> operator()(T a, T b) const { return a | b; }
+};
+
+struct BitXor {
+	template<typename T> IfInt<T> operator()(T a, T b) const { return a ^ b; }
+};
+
+/// Balra léptetés, csak 0 és 63 közötti lépésszámra.
+struct ShiftLeft {
+	template<typename T> IfInt<T, std::optional<T>> operator()(T a, T b) const {
+		if (b < 0 || b >= 64) return std::nullopt;
+		return (T)((uint64_t)a << b);
+	}
+};
+
+/// Aritmetikai jobbra léptetés, csak 0 és 63 közötti lépésszámra.
+struct ShiftRight {
+	template<typename T> IfInt<T, std::optional<T>> operator()(T a, T b) const {
+		if (b < 0 || b >= 64) return std::nullopt;
+		return a >> b;
+	}
+};
+/// @}
+
+#endif
@@ -7,9 +7,11 @@
 #include <vector>
 #include <iostream>
 #include <cstdint>
+#include <thread>
 
 #include "parser.h"
 #include "tokenizer.h"
+#include "hashmap.h"
 
 #define ERROR "[\x1b[91mERROR\x1b[m] "
 
@@ -56,9 +58,12 @@ parse(std::vector<Token*>::const_iterator& it, std::vector<Token*>::const_iterat
 				
 				// found block initializer word, recursively parse a block.
 				else if (**it == TTWord("[")) {
+					SourceLocation location = (*it)->location;
 					std::optional<std::vector<Object*>> blockdata = parse(++it, end, true, false);
 					if (!blockdata) return std::nullopt;
-					result.push_back( new OTBlock(blockdata.value()) );
+					OTBlock* b = new OTBlock(blockdata.value());
+					b->location = location;
+					result.push_back(b);
 					for (Object* o: blockdata.value())
 						delete o;
 				}
@@ -89,7 +94,59 @@ parse(std::vector<Token*>::const_iterator& it, std::vector<Token*>::const_iterat
 }
 
 
-std::ostream& operator<<(std::ostream& stream, Object const& o) {
+/// Ennél kevesebb tokenre nem érdemes szálat indítani.
+static constexpr size_t MIN_FORMS = 1 << 16;
+
+std::optional<std::vector<Object*>> parse_parallel(std::vector<Token*> const& tokens, unsigned threads) {
+	auto serial = [&](void) {
+		std::vector<Token*>::const_iterator begin = tokens.cbegin();
+		return parse(begin, tokens.cend());
+	};
+	size_t parts = std::min<size_t>(threads, tokens.size() / MIN_FORMS);
+	if (parts < 2) return serial();
+
+	// split between top-level forms; brackets are checked here, so the parts cannot fail
+	std::vector<size_t> splits{0};
+	std::vector<char> open;
+	for (size_t i = 0; i < tokens.size(); i++) {
+		if (open.empty() && splits.size() < parts && i >= tokens.size() * splits.size() / parts)
+			splits.push_back(i);
+		if (tokens[i]->type() != Token::Word) continue;
+		std::string const& w = *(const std::string*)tokens[i]->get_value();
+		if (w == "[" || w == "{") {
+			open.push_back(w[0]);
+		} else if ((w == "]" || w == "}") && !open.empty()) {
+			// mismatched, let the serial parser report it
+			if ((open.back() == '[') != (w == "]")) return serial();
+			open.pop_back();
+		}
+		// at the top level closing brackets are ordinary words
+	}
+	if (!open.empty()) return serial();
+	splits.push_back(tokens.size());
+
+	std::vector<std::optional<std::vector<Object*>>> parts_parsed(splits.size() - 1);
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < parts_parsed.size(); i++)
+		workers.emplace_back([&, i](void) {
+			std::vector<Token*>::const_iterator begin = tokens.cbegin() + splits[i];
+			parts_parsed[i] = parse(begin, tokens.cbegin() + splits[i + 1]);
+		});
+	for (std::thread& w: workers) w.join();
+
+	std::vector<Object*> result;
+	for (auto& p: parts_parsed)
+		result.insert(result.end(), p->begin(), p->end());
+	return std::optional<std::vector<Object*>>(std::move(result));
+}
+
+
+std::ostream& print_object(std::ostream& stream, Object const& o, size_t limit) {
+	// the items left out of a long container
+	auto rest = [&](size_t count) -> std::ostream& {
+		if (count > limit) stream << "... (" << count - limit << " more)";
+		return stream;
+	};
 	switch (o.type()) {
 		case Object::Int:
 			return stream << *(int64_t*)o.get_value();
@@ -98,21 +155,56 @@ std::ostream& operator<<(std::ostream& stream, Object const& o) {
 		case Object::Word: 
 			return stream << *(std::string*)o.get_value();
 		case Object::String:
-			return stream << *(std::string*)o.get_value();
+			return stream << ((OTString const&)o).view();
 		case Object::Block: {
+			std::vector<Object*> const& code = *(std::vector<Object*>*)o.get_value();
 			stream << "Block([";
-			for (const Object* obj: *(std::vector<Object*>*)o.get_value())
-				stream << *obj << ", ";
-			return stream << "])";
+			for (size_t i = 0; i < code.size() && i < limit; i++)
+				print_object(stream, *code[i], limit) << ", ";
+			return rest(code.size()) << "])";
 		}
 		case Object::List: {
+			OTList const& l = (OTList const&)o;
 			stream << "List({";
-			for (const Object* obj: *(std::vector<Object*>*)o.get_value())
-				stream << *obj << ",\n";
-			return stream << "})";
+			for (size_t i = 0; i < l.size() && i < limit; i++)
+				print_object(stream, *l.at(i), limit) << ",\n";
+			return rest(l.size()) << "})";
 		}
+		case Object::Array: {
+			OTArray const& a = (OTArray const&)o;
+			stream << "Array({";
+			for (size_t i = 0; i < a.size() && i < limit; i++) {
+				if (a.element_type() == Object::Int)
+					stream << a.int_at(i) << ", ";
+				else
+					stream << a.float_at(i) << ", ";
+			}
+			return rest(a.size()) << "})";
+		}
+		case Object::Stream:
+			return stream << "Stream(...)";
+		case Object::Map: {
+			stream << "Map({";
+			size_t count = 0;
+			((OTMap const&)o).table().for_each([&](Object* k, Object* v) {
+				if (count++ < limit) {
+					print_object(stream, *k, limit) << ": ";
+					print_object(stream, *v, limit) << ",\n";
+				}
+				delete k; delete v;
+			});
+			return rest(count) << "})";
+		}
+		case Object::Task:
+			return stream << "Task(...)";
+		case Object::Channel:
+			return stream << "Channel(...)";
 	}
 	return stream;
 }
 
+std::ostream& operator<<(std::ostream& stream, Object const& o) {
+	return print_object(stream, o, SIZE_MAX);
+}
+
 
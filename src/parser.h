@@ -10,8 +10,11 @@
 #include <string>
 #include <optional>
 #include <ostream>
+#include <memory>
+#include <string_view>
 
 #include "tokenizer.h"
+#include "pool.h"
 
 /// Program futása közben használt objektum.
 /**
@@ -41,7 +44,17 @@ public:
 		/// Blokk
 		Block = 0x04,
 		/// Egyéb szó
-		Word = 0x05
+		Word = 0x05,
+		/// Számtömb
+		Array = 0x06,
+		/// Lusta sorozat
+		Stream = 0x07,
+		/// Hash tábla
+		Map = 0x08,
+		/// Párhuzamosan futó feladat
+		Task = 0x09,
+		/// Feladatok közötti csatorna
+		Channel = 0x0A
 	};
 
 	/// Objektum típusának lekérdezése.
@@ -57,13 +70,30 @@ public:
 
 	/// Mély másolat készítése.
 	/**
-	 * Mély másolatot készít önmagáról, pl. lista az elemeit is klónozza.
-	 * @todo Ne abuzáljam ennyire.
+	 * Logikailag mély másolatot készít önmagáról. A megosztott tárolójú 
+	 * objektumok (pl. lista) az elemeiket csak akkor másolják le, ha módosítják őket.
 	 * @returns Pointer egy új objektumra, amelyet a hívó birtokol.
 	 */
 	virtual Object* clone(void) const = 0;
 
+	/// Előkészítés több szál közötti megosztásra.
+	/**
+	 * A listák és szövegek az első másoláskor helyezik át az elemeiket egy
+	 * megosztott tárolóba, ami a másolt objektumot is módosítja. Ezután a
+	 * hívás után (a beágyazott elemekre is) ez már megtörtént, így az
+	 * objektumot több szál is másolhatja egyszerre, amíg semmi mást nem
+	 * csinálnak vele.
+	 */
+	virtual void freeze(void) const {}
+
 	virtual ~Object(void) {}
+
+#ifdef STACC_POOL_ALLOCATOR
+	/// Objektumok foglalása a pool allokátorral (lásd pool.h).
+	static void* operator new(size_t size) { return pool_allocate(size); }
+	/// A virtuális destruktor miatt a \c size a tényleges típus mérete.
+	static void operator delete(void* p, size_t size) { pool_free(p, size); }
+#endif
 };
 
 /// Egész érték.
@@ -96,102 +126,364 @@ public:
 
 /// Meghívható (vagy definiálandó) szó.
 class OTWord: public Object {
-	std::string* value;
+	std::string value;
 public:
-	OTWord(const char* s): value(new std::string(s)) {}
-	OTWord(std::string const& s): value(new std::string(s)) {}
+	/// Ha egy beillesztett szó törzséből való (lásd Dictionary): a beillesztett szavak, a legbelsővel kezdve.
+	/// A hibaüzenet ezeket is kiírja, mintha a hívásuk szakadt volna meg.
+	std::shared_ptr<const std::vector<std::string>> inlined;
+
+	OTWord(const char* s): value(s) {}
+	OTWord(std::string const& s): value(s) {}
 	
 	Object::Type type(void) const override { return Object::Word; }
 
-	void* get_value(void) override { return value; }
-	const void* get_value(void) const override { return value; }
-
-	OTWord* clone(void) const override { return new OTWord(*value); }
+	void* get_value(void) override { return &value; }
+	const void* get_value(void) const override { return &value; }
 
-	~OTWord(void) { delete value; }
+	OTWord* clone(void) const override {
+		OTWord* w = new OTWord(value);
+		w->inlined = inlined;
+		return w;
+	}
 };
 
 /// Olyan objektum-kollekció, amit le tudunk futtatni.
+/**
+ * A blokkok futás közben nem változnak, ezért a tartalmuk megosztott: a 
+ * másolás (pl. egy blokk literál a verembe tételekor) nem másolja az elemeket.
+ */
 class OTBlock: public Object {
-	std::vector<Object*>* value;
+	std::shared_ptr<std::vector<Object*>> value;
+
+	/// Tároló, ami a törlésekor az elemeit is törli.
+	static std::shared_ptr<std::vector<Object*>> make_storage(std::vector<Object*>* v) {
+		return std::shared_ptr<std::vector<Object*>>(v, [](std::vector<Object*>* p) {
+			for (Object* o: *p) delete o;
+			delete p;
+		});
+	}
 public:
-	OTBlock(void): value(new std::vector<Object*>()) {}
-	OTBlock(Object const& o): value(new std::vector<Object*>()) { value->push_back(o.clone()); }
-	OTBlock(std::vector<Object*> const& v): value(new std::vector<Object*>()) {
+	/// A blokk helye a forrásban (a nyitó \c [ helye), ha forrásból jött.
+	SourceLocation location;
+
+	OTBlock(void): value(make_storage(new std::vector<Object*>())) {}
+	OTBlock(Object const& o): OTBlock() { value->push_back(o.clone()); }
+	OTBlock(std::vector<Object*> const& v): OTBlock() {
+		value->reserve(v.size());
 		for (const Object* o: v) value->push_back(o->clone());
 	}
-	OTBlock(OTBlock const& b): value(new std::vector<Object*>()) {
-		for (const Object* o: *(std::vector<Object*>*)b.get_value()) value->push_back(o->clone());
-	}
+	OTBlock(OTBlock const& b) = default;
 
 	Object::Type type(void) const override { return Object::Block; }
 	
-	void* get_value(void) override { return value; }
-	const void* get_value(void) const override {return value; }
+	/// @warning A tartalom megosztott, nem szabad módosítani!
+	void* get_value(void) override { return value.get(); }
+	const void* get_value(void) const override {return value.get(); }
 
-	OTBlock* clone(void) const override {
-		OTBlock* result = new OTBlock();
-		for (const Object* o: *value)
-			((std::vector<Object*>*)result->get_value())->push_back(o->clone());
-		return result;
-	}
-	~OTBlock(void) {
-		for (Object* o: *value)
-			delete o;
-		delete value;
+	OTBlock* clone(void) const override { return new OTBlock(*this); }
+
+	/// A tárolón osztozó blokkok száma.
+	long use_count(void) const { return value.use_count(); }
+	/// Nem birtokló hivatkozás a tárolóra, a tároló törlésekor lejár.
+	std::weak_ptr<const void> storage(void) const { return value; }
+
+	void freeze(void) const override {
+		for (const Object* o: *value) o->freeze();
 	}
 };
 
 /// Rendezett heterogén gyűjtemény.
+/**
+ * Amíg nincs megosztva, az elemek közvetlenül az objektumban vannak. A másolat
+ * (pl. \c dup) és a nézetek (pl. \c slice) esetén az elemek egy megosztott
+ * tárolóba kerülnek, és mindegyik ugyanazt a tárolót használja (eltolás, hossz,
+ * lépésköz). Saját elemeket csak akkor készít (copy-on-write), ha módosítani 
+ * akarják, azaz a get_value() hívásakor. Olvasáshoz a size() és at() használandó.
+ */
 class OTList: public Object {
-	std::vector<Object*>* value; 
+	/// A saját elemek, ha nincs megosztott tároló.
+	mutable std::vector<Object*> value;
+	/// A megosztott tároló, a törlője az elemeket is törli.
+	mutable std::shared_ptr<std::vector<Object*>> shared;
+	mutable size_t offset, length, stride;
+	/// A megosztott tároló egészét látja-e (nem nézet), ekkor a \c length nem használt.
+	mutable bool whole;
+
+	/// A saját elemek áthelyezése egy megosztott tárolóba.
+	void share(void) const {
+		if (shared) return;
+		shared = std::shared_ptr<std::vector<Object*>>(new std::vector<Object*>(std::move(value)), [](std::vector<Object*>* p) {
+			for (Object* o: *p) delete o;
+			delete p;
+		});
+		value.clear();
+		offset = 0; stride = 1; whole = true;
+	}
+
+	/// Saját elemek készítése a megosztott tárolóból.
+	void materialize(void) const {
+		if (!shared) return;
+		if (whole && shared.use_count() == 1) {
+			// nobody else sees the elements, they can be taken over
+			value = std::move(*shared);
+			shared->clear();
+		} else {
+			value.reserve(size());
+			for (size_t i = 0; i < size(); i++) value.push_back(at(i)->clone());
+		}
+		shared.reset();
+	}
 public:
-	OTList(void): value(new std::vector<Object*>()) {}
-	OTList(nullptr_t): value(nullptr) {}
-	OTList(Object const& o): value(new std::vector<Object*>()) { value->push_back(o.clone()); } 
-	OTList(std::vector<Object*> const& v): value (new std::vector<Object*>()) {
-		for (const Object* o: v) value->push_back(o->clone());
+	OTList(void): offset(0), length(0), stride(1), whole(true) {}
+	OTList(Object const& o): OTList() { value.push_back(o.clone()); } 
+	OTList(std::vector<Object*> const& v): OTList() {
+		value.reserve(v.size());
+		for (const Object* o: v) value.push_back(o->clone());
+	}
+	OTList(OTList const& l): OTList() {
+		l.share();
+		shared = l.shared; offset = l.offset; length = l.length; stride = l.stride; whole = l.whole;
 	}
-	OTList(OTList const& l): value(new std::vector<Object*>()) {
-		for (const Object* o: *(std::vector<Object*>*)l.get_value()) value->push_back(o->clone());
+	/// Nézet egy másik listára.
+	/**
+	 * @param l A lista, aminek az elemeit látja.
+	 * @param from Az első elem indexe \c l -ben.
+	 * @param count Az elemek száma.
+	 * @param step Két elem távolsága \c l -ben.
+	 * @warning A határokat nem ellenőrzi!
+	 */
+	OTList(OTList const& l, size_t from, size_t count, size_t step = 1): OTList(l) {
+		offset += from * stride; length = count; stride *= step; whole = false;
 	}
 	
 	Object::Type type(void) const override { return Object::List; }
 	
-	void* get_value(void) override { return value; }
-	const void* get_value(void) const override { return value; }
+	void* get_value(void) override { materialize(); return &value; }
+	const void* get_value(void) const override { materialize(); return &value; }
 
-	OTList* clone(void) const override {
-		OTList* result = new OTList();
-		for (const Object* o: *value)
-			((std::vector<Object*>*)result->get_value())->push_back(o->clone());
-		return result;
+	OTList* clone(void) const override { return new OTList(*this); }
+
+	void freeze(void) const override {
+		share();
+		for (size_t i = 0; i < size(); i++) at(i)->freeze();
 	}
+
+	/// Az elemek száma.
+	size_t size(void) const { return !shared ? value.size() : whole ? shared->size() : length; }
+	/// Egy elem, módosítás nélküli olvasáshoz. A lista birtokolja.
+	const Object* at(size_t i) const { return !shared ? value[i] : (*shared)[offset + i * stride]; }
+
 	~OTList(void) {
-		if (!value)
-			return;
-		for (Object* o: *value)
-			delete o;
-		delete value;
+		for (Object* o: value) delete o;
 	}
 };
 
 /// Karakterlánc.
+/**
+ * A lista (OTList) mintájára a hosszabb szövegek másolatai és a nézetei 
+ * (pl. \c slice) megosztják a karaktereket. A rövid szövegek közvetlenül az
+ * objektumban vannak. Olvasáshoz a view() használandó.
+ */
 class OTString: public Object {
-	std::string* value;
+	/// A saját szöveg, ha nincs megosztott tároló.
+	mutable std::string value;
+	mutable std::shared_ptr<std::string> shared;
+	mutable size_t offset, length;
+	mutable bool whole;
+
+	/// Ennél nem hosszabb szövegeket a másoláskor nem osztunk meg (nem foglalnak memóriát).
+	static constexpr size_t SMALL_STRING = 15;
+
+	/// A saját szöveg áthelyezése egy megosztott tárolóba.
+	void share(void) const {
+		if (shared) return;
+		shared = std::make_shared<std::string>(std::move(value));
+		value.clear();
+		offset = 0; whole = true;
+	}
+
+	/// Saját szöveg készítése a megosztott tárolóból.
+	void materialize(void) const {
+		if (!shared) return;
+		if (whole && shared.use_count() == 1) value = std::move(*shared);
+		else value = std::string(view());
+		shared.reset();
+	}
 public:
-	OTString(void): value(new std::string()) {}
-	OTString(std::string const& s): value(new std::string(s)) {}
-	OTString(OTString const& s): value( new std::string(*(std::string*)s.get_value()) ) {}
+	OTString(void): offset(0), length(0), whole(true) {}
+	OTString(std::string const& s): value(s), offset(0), length(0), whole(true) {}
+	OTString(std::string&& s): value(std::move(s)), offset(0), length(0), whole(true) {}
+	OTString(OTString const& s): OTString() {
+		if (!s.shared && s.value.size() <= SMALL_STRING) {
+			value = s.value;
+			return;
+		}
+		s.share();
+		shared = s.shared; offset = s.offset; length = s.length; whole = s.whole;
+	}
+	/// Nézet egy másik szövegre.
+	/// @warning A határokat nem ellenőrzi!
+	OTString(OTString const& s, size_t from, size_t count): OTString() {
+		s.share();
+		shared = s.shared; offset = s.offset + from; length = count; whole = false;
+	}
 
 	Object::Type type(void) const override { return Object::String; }
 
-	void* get_value(void) override { return value; }
-	const void* get_value(void) const override { return value; }
+	void* get_value(void) override { materialize(); return &value; }
+	const void* get_value(void) const override { materialize(); return &value; }
+
+	OTString* clone(void) const override { return new OTString(*this); }
 
-	OTString* clone(void) const override { return new OTString(*value); }
+	void freeze(void) const override { share(); }
 
-	~OTString(void) { delete value; }
+	/// A szöveg, módosítás nélküli olvasáshoz.
+	std::string_view view(void) const {
+		if (!shared) return value;
+		return whole ? std::string_view(*shared) : std::string_view(shared->data() + offset, length);
+	}
+};
+
+/// Számtömb nyers tárolója.
+/**
+ * Dobozolatlan, egymás után elhelyezkedő elemek csak olvasható tárolója. 
+ * Lehet saját memória (OwnedBuffer) vagy memóriába leképezett fájl is.
+ */
+class ArrayBuffer {
+public:
+	/// Az első elemre mutató pointer.
+	virtual const void* data(void) const = 0;
+	/// A tárolt adat mérete bájtokban.
+	virtual size_t size(void) const = 0;
+
+	virtual ~ArrayBuffer(void) {}
+};
+
+/// Saját memóriában tárolt számtömb.
+/// @tparam T Az elemek típusa (\c int64_t vagy \c double).
+template<typename T> class OwnedBuffer: public ArrayBuffer {
+	std::vector<T> items;
+public:
+	OwnedBuffer(std::vector<T>&& v): items(std::move(v)) {}
+
+	const void* data(void) const override { return items.data(); }
+	size_t size(void) const override { return items.size() * sizeof(T); }
+};
+
+/// Homogén, dobozolatlan számtömb.
+/**
+ * Egészek vagy valósak listája, az elemek nem külön objektumként, hanem egy
+ * megosztott pufferben vannak. A puffer soha nem változik, ezért a másolás 
+ * (pl. \c dup) és a nézetek (eltolás, hossz, lépésköz) csak a pufferre mutató 
+ * referenciát másolják.
+ */
+class OTArray: public Object {
+	std::shared_ptr<const ArrayBuffer> buffer;
+	Object::Type elem;
+	size_t offset, length, step;
+public:
+	/// @param b Az elemeket tároló puffer.
+	/// @param t Az elemek típusa, \c Object::Int vagy \c Object::Float.
+	OTArray(std::shared_ptr<const ArrayBuffer> b, Object::Type t)
+		: buffer(std::move(b)), elem(t), offset(0), length(buffer->size() / 8), step(1) {}
+	/// Nézet egy másik tömbre.
+	/// @warning A határokat nem ellenőrzi!
+	/// @see OTList::OTList(OTList const&, size_t, size_t, size_t)
+	OTArray(OTArray const& a, size_t from, size_t count, size_t s = 1)
+		: buffer(a.buffer), elem(a.elem), offset(a.offset + from * a.step), length(count), step(a.step * s) {}
+
+	Object::Type type(void) const override { return Object::Array; }
+
+	/// @warning A visszaadott memória csak olvasható (pl. leképezett fájl)!
+	void* get_value(void) override { return (char*)buffer->data() + offset * 8; }
+	const void* get_value(void) const override { return (const char*)buffer->data() + offset * 8; }
+
+	OTArray* clone(void) const override { return new OTArray(*this); }
+
+	/// Az elemek típusa.
+	Object::Type element_type(void) const { return elem; }
+	/// Az elemek száma.
+	size_t size(void) const { return length; }
+	/// Két egymás utáni elem távolsága a pufferben (elemekben mérve).
+	size_t stride(void) const { return step; }
+	/// Az első elemre mutató pointer, egészként. Az i. elem: \c ints()[i * stride()].
+	const int64_t* ints(void) const { return (const int64_t*)get_value(); }
+	/// Az első elemre mutató pointer, valósként. Az i. elem: \c floats()[i * stride()].
+	const double* floats(void) const { return (const double*)get_value(); }
+	/// Az i. elem egészként.
+	int64_t int_at(size_t i) const { return ints()[i * step]; }
+	/// Az i. elem valósként.
+	double float_at(size_t i) const { return floats()[i * step]; }
+
+	/// Egy elem objektumként.
+	/// @returns Új objektum, amelyet a hívó birtokol.
+	Object* at(size_t i) const {
+		if (elem == Object::Int) return new OTInt(int_at(i));
+		return new OTFloat(float_at(i));
+	}
+};
+
+class Source;
+
+/// Lusta, egyszer bejárható sorozat.
+/**
+ * Az elemeket csak akkor állítja elő a forrás, amikor a sorozatot feldolgozó
+ * szó (pl. \c reduce1) kéri őket, így a sorozat nem kell beférjen a memóriába.
+ * A másolatok (pl. \c dup) ugyanazt a forrást használják, tehát egy elemet
+ * csak az egyikük kap meg.
+ */
+class OTStream: public Object {
+	std::shared_ptr<Source> value;
+public:
+	OTStream(std::shared_ptr<Source> s): value(std::move(s)) {}
+
+	Object::Type type(void) const override { return Object::Stream; }
+
+	void* get_value(void) override { return value.get(); }
+	const void* get_value(void) const override { return value.get(); }
+
+	OTStream* clone(void) const override { return new OTStream(value); }
+
+	/// A sorozat forrása.
+	std::shared_ptr<Source> const& source(void) const { return value; }
+};
+
+class Task;
+class Channel;
+
+/// Párhuzamosan futó feladat (lásd tasks.h).
+/**
+ * A másolatok ugyanazt a feladatot jelölik, bármelyikükkel be lehet várni.
+ */
+class OTTask: public Object {
+	std::shared_ptr<::Task> value;
+public:
+	OTTask(std::shared_ptr<::Task> t): value(std::move(t)) {}
+
+	Object::Type type(void) const override { return Object::Task; }
+
+	void* get_value(void) override { return value.get(); }
+	const void* get_value(void) const override { return value.get(); }
+
+	OTTask* clone(void) const override { return new OTTask(value); }
+};
+
+/// Feladatok közötti csatorna (lásd tasks.h).
+/**
+ * A másolatok ugyanazt a csatornát használják, így egy feladat a vermén
+ * kapott csatornán keresztül beszélhet a többivel.
+ */
+class OTChannel: public Object {
+	std::shared_ptr<::Channel> value;
+public:
+	OTChannel(std::shared_ptr<::Channel> c): value(std::move(c)) {}
+
+	Object::Type type(void) const override { return Object::Channel; }
+
+	void* get_value(void) override { return value.get(); }
+	const void* get_value(void) const override { return value.get(); }
+
+	OTChannel* clone(void) const override { return new OTChannel(value); }
 };
 
 /// Szintaktikai analízist végez tokenizált programon.
@@ -209,8 +501,28 @@ std::optional<std::vector<Object*>> parse(
 	bool list = false
 );
 
+/// Tokenizált program szintaktikai analízise több szálon.
+/**
+ * A programot legfelső szintű formák (blokkokon és listákon kívül) határán
+ * darabokra vágja, és a darabokat párhuzamosan elemzi. Hibás zárójelezés
+ * esetén a hibát a soros parse() jelzi.
+ * @param tokens A tokenlista.
+ * @param threads Legfeljebb ennyi szálat használ. Kis programra nem indít szálat.
+ * @returns Mint parse().
+ */
+std::optional<std::vector<Object*>> parse_parallel(std::vector<Token*> const& tokens, unsigned threads);
+
 /// Inserter
 /// @deprecated Valószínűleg további haszna nincs.
 std::ostream& operator<<(std::ostream& stream, Object const& o);
 
+/// Objektum kiírása rövidítve.
+/**
+ * Mint az \c operator<<, de a listákból, tömbökből, blokkokból és hash
+ * táblákból (a beágyazottakból is) csak az első \c limit elemet írja ki, a
+ * többinek csak a számát.
+ * @param limit Ennyi elemet ír ki tárolónként.
+ */
+std::ostream& print_object(std::ostream& stream, Object const& o, size_t limit);
+
 #endif
@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @brief Méretosztályos pool allokátor implementáció.
+ *
+ * A memóriát nagy lapokban (slab) kérjük, és ezeket felszabdaljuk egy
+ * méretosztály darabjaira. A lapokat soha nem adjuk vissza, a felszabadított
+ * darabok a szál szabadlistájára kerülnek. Kilépő szál szabadlistái egy
+ * közös raktárba kerülnek, amiből a többi szál utántölthet. Ugyanígy jár az
+ * a szál is, amelyik jóval többet szabadít fel, mint amennyit foglal (pl. egy
+ * csatornából olvasó feladat), különben a foglaló szál egyre új lapokat kérne.
+ */
+#include <new>
+#include <cstdlib>
+#include <mutex>
+
+#include "pool.h"
+
+/// A méretosztályok közötti különbség (és az igazítás).
+static constexpr size_t GRANULE = 16;
+/// A méretosztályok száma.
+static constexpr size_t CLASSES = POOL_MAX_SIZE / GRANULE;
+/// Egy lap mérete.
+static constexpr size_t SLAB_SIZE = 64 * 1024;
+/// Ha egy szál ennyi bájttal többet szabadít fel egy méretosztályban, mint amennyit foglal, a raktárba teszi a szabadlistáját.
+static constexpr ptrdiff_t SURPLUS_LIMIT = 4 * SLAB_SIZE;
+
+/// Szabad darab, a következő szabad darabra mutat.
+struct FreeNode {
+	FreeNode* next;
+};
+
+/// Közös raktár a kilépett szálak szabadlistáinak.
+struct Depot {
+	std::mutex lock;
+	FreeNode* lists[CLASSES] = {};
+};
+
+static Depot& depot(void) {
+	// never destroyed, threads may exit after static destructors have run
+	static Depot* d = new Depot();
+	return *d;
+}
+
+/// Egy szál szabadlistái.
+struct ThreadCache {
+	FreeNode* lists[CLASSES] = {};
+	/// Méretosztályonként a felszabadított és a foglalt darabok számának különbsége.
+	ptrdiff_t surplus[CLASSES] = {};
+	/// Lásd pool_allocated().
+	int64_t allocated = 0;
+
+	/// Egy szabadlista áthelyezése a raktárba.
+	/// @param keep Ennyi darabot megtart, hogy ne töltse utána rögtön vissza a raktárból.
+	void release(size_t c, size_t keep) {
+		FreeNode* head = lists[c];
+		FreeNode* last = nullptr;
+		for (size_t i = 0; i < keep && head; i++) {
+			last = head;
+			head = head->next;
+		}
+		if (!head) return;
+		if (last) last->next = nullptr;
+		else lists[c] = nullptr;
+		FreeNode* tail = head;
+		while (tail->next) tail = tail->next;
+		Depot& d = depot();
+		std::lock_guard<std::mutex> guard(d.lock);
+		tail->next = d.lists[c];
+		d.lists[c] = head;
+	}
+
+	~ThreadCache(void) {
+		for (size_t c = 0; c < CLASSES; c++)
+			if (lists[c]) release(c, 0);
+	}
+};
+
+static thread_local ThreadCache cache;
+
+/// Szabadlista feltöltése a raktárból, vagy egy új lapból.
+static FreeNode* refill(size_t c) {
+	{
+		Depot& d = depot();
+		std::lock_guard<std::mutex> guard(d.lock);
+		if (d.lists[c]) {
+			FreeNode* list = d.lists[c];
+			d.lists[c] = nullptr;
+			return list;
+		}
+	}
+
+	size_t size = (c + 1) * GRANULE;
+	// not operator new: the memory limit counts the objects (pool_allocated()), not the slabs
+	char* slab = (char*)std::malloc(SLAB_SIZE);
+	if (!slab) throw std::bad_alloc();
+	size_t count = SLAB_SIZE / size;
+	for (size_t i = 0; i + 1 < count; i++)
+		((FreeNode*)(slab + i * size))->next = (FreeNode*)(slab + (i + 1) * size);
+	((FreeNode*)(slab + (count - 1) * size))->next = nullptr;
+	return (FreeNode*)slab;
+}
+
+void* pool_allocate(size_t size) {
+	if (size == 0 || size > POOL_MAX_SIZE) return ::operator new(size);
+	size_t c = (size - 1) / GRANULE;
+	FreeNode* node = cache.lists[c];
+	if (!node) node = refill(c);
+	cache.lists[c] = node->next;
+	cache.surplus[c]--;
+	cache.allocated += (int64_t)((c + 1) * GRANULE);
+	return node;
+}
+
+void pool_free(void* p, size_t size) {
+	if (!p) return;
+	if (size == 0 || size > POOL_MAX_SIZE) {
+		::operator delete(p);
+		return;
+	}
+	size_t c = (size - 1) / GRANULE;
+	FreeNode* node = (FreeNode*)p;
+	node->next = cache.lists[c];
+	cache.lists[c] = node;
+	cache.allocated -= (int64_t)((c + 1) * GRANULE);
+	if (++cache.surplus[c] * (ptrdiff_t)size > SURPLUS_LIMIT) {
+		cache.release(c, SLAB_SIZE / size);
+		cache.surplus[c] = 0;
+	}
+}
+
+int64_t pool_allocated(void) {
+	return cache.allocated;
+}
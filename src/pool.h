@@ -0,0 +1,39 @@
+/**
+ * @file
+ * @brief Futás közbeni objektumok memóriakezelése.
+ *
+ * A program futása közben szinte minden szó létrehoz és töröl objektumokat,
+ * ezért ezeket nem a \c malloc kezeli, hanem méretosztályonkénti szabadlisták.
+ * A szabadlisták szálanként (így interpreterenként) külön vannak, zárolás nélkül.
+ * Fordításkor a \c STACC_POOL_ALLOCATOR makró kapcsolja be (lásd Makefile, \c ALLOCATOR).
+ */
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Memória foglalása a hívó szál szabadlistájáról.
+/**
+ * A \c POOL_MAX_SIZE -nál nagyobb kérések a rendes \c operator \c new -hoz mennek.
+ * @param size A foglalandó bájtok száma.
+ * @returns Legalább \c size bájtos, 16 bájtra igazított memória.
+ */
+void* pool_allocate(size_t size);
+
+/// Memória felszabadítása a hívó szál szabadlistájára.
+/**
+ * A memóriát nem kell ugyanaz a szál felszabadítsa, amelyik lefoglalta.
+ * @param p A pool_allocate() által visszaadott pointer.
+ * @param size A foglaláskor kért méret.
+ */
+void pool_free(void* p, size_t size);
+
+/// A hívó szál által a poolból foglalt és felszabadított bájtok különbsége (méretosztályra kerekítve).
+/// A memóriakorlát (memory.h) ebből számolja a pool objektumait, a lapokat nem.
+int64_t pool_allocated(void);
+
+/// Ennél nagyobb foglalásokat nem kezel a pool.
+constexpr size_t POOL_MAX_SIZE = 256;
+
+#endif
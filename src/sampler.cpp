@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @brief Mintavételező profilozó implementáció.
+ */
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include "sampler.h"
+
+Sampler* Sampler::active = nullptr;
+
+/// A mintapuffer kezdeti mérete (elemekben).
+static constexpr size_t INITIAL_SAMPLES = 1 << 16;
+
+Sampler::Sampler(size_t hz, std::string output, bool& ok): samples(INITIAL_SAMPLES), path(std::move(output)) {
+	active = this;
+	struct sigaction action;
+	memset(&action, 0, sizeof action);
+	action.sa_handler = on_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGPROF, &action, nullptr);
+
+	// only this thread runs the interpreter, the signal has to arrive here
+	sigevent event;
+	memset(&event, 0, sizeof event);
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGPROF;
+	event._sigev_un._tid = (pid_t)syscall(SYS_gettid);
+	ok = timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) == 0;
+	if (!ok) return;
+	running = true;
+
+	long ns = hz ? (long)(1000000000 / hz) : 1000000000;
+	if (ns == 0) ns = 1;
+	itimerspec interval;
+	interval.it_interval.tv_sec = ns / 1000000000;
+	interval.it_interval.tv_nsec = ns % 1000000000;
+	interval.it_value = interval.it_interval;
+	ok = timer_settime(timer, 0, &interval, nullptr) == 0;
+}
+
+Sampler::~Sampler(void) {
+	if (running) timer_delete(timer);
+	signal(SIGPROF, SIG_IGN);
+	active = nullptr;
+}
+
+void Sampler::on_signal(int) {
+	if (active) active->sample();
+}
+
+void Sampler::sample(void) {
+	uint32_t d = depth;
+	std::atomic_signal_fence(std::memory_order_acquire);
+	uint32_t n = d < MAX_DEPTH ? d : MAX_DEPTH;
+	size_t at = used;
+	if (at + n + 1 > samples.size()) {
+		dropped = dropped + 1;
+		return;
+	}
+	Frame* out = samples.data() + at;
+	out[0] = Frame{nullptr, n, Frame::Header};
+	// the outermost frames are overwritten in a deeper stack
+	for (uint32_t i = 0; i < n; i++)
+		out[1 + i] = frames[(d - n + i) % MAX_DEPTH];
+	used = at + n + 1;
+}
+
+void Sampler::grow(void) {
+	sigset_t prof, old;
+	sigemptyset(&prof);
+	sigaddset(&prof, SIGPROF);
+	pthread_sigmask(SIG_BLOCK, &prof, &old);
+	samples.resize(samples.size() * 2);
+	pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+std::string Sampler::label(Frame const& f) const {
+	if (f.kind == Frame::Word) return symbols.name(f.value);
+	if (f.value == 0) return "[block]";
+	return "[" + std::string(f.file ? f.file : "line") + (f.file ? ":" : " ") + std::to_string(f.value) + "]";
+}
+
+bool Sampler::write(void) {
+	if (running) {
+		timer_delete(timer);
+		running = false;
+	}
+
+	std::map<std::string, size_t> stacks;
+	for (size_t i = 0; i < used; ) {
+		uint32_t n = samples[i].value;
+		std::string stack;
+		for (uint32_t j = 0; j < n; j++) {
+			if (j) stack += ';';
+			stack += label(samples[i + 1 + j]);
+		}
+		stacks[n ? stack : "(top level)"]++;
+		i += n + 1;
+	}
+	if (dropped) stacks["(dropped)"] += dropped;
+
+	std::ofstream f(path, std::ios::trunc);
+	for (auto const& [stack, count]: stacks)
+		f << stack << " " << count << "\n";
+	return f.good();
+}
@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @brief Mintavételező profilozó (\c --sample=HZ).
+ *
+ * Az interpreter egy külön tömbben (logikai hívási verem) tartja nyilván a
+ * futó szavakat és blokkokat. Egy időzítő adott frekvenciával \c SIGPROF
+ * jelzést küld a futtató szálnak, amelynek kezelője ezt a tömböt másolja egy
+ * előre lefoglalt pufferbe. A futás végén a mintákat összesítve "folded
+ * stacks" formátumban írja ki (soronként a hívási lánc \c ; -vel elválasztva,
+ * majd a minták száma), amit pl. a \c flamegraph.pl vagy a speedscope megjelenít.
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include "symbols.h"
+#include "tokenizer.h"
+
+/// Mintavételező profilozó, egyszerre csak egy lehet.
+class Sampler {
+public:
+	/// A logikai hívási verem egy eleme.
+	struct Frame {
+		/// Blokknál a forrásfájl neve.
+		const char* file;
+		/// Szónál az azonosítója, blokknál a sor, mintafejlécnél a minta hossza.
+		uint32_t value;
+		enum Kind: uint32_t { Word, Block, Header } kind;
+	};
+
+	/// A szavak azonosítói.
+	SymbolTable symbols;
+
+	/// Az időzítő elindítása a hívó szálra.
+	/**
+	 * @param hz A mintavételezés frekvenciája (a szál processzoridejében mérve).
+	 * @param output A kimeneti fájl elérési útja.
+	 * @param[out] ok Hamis, ha az időzítőt nem sikerült elindítani (\c errno beállítva).
+	 */
+	Sampler(size_t hz, std::string output, bool& ok);
+	~Sampler(void);
+
+	Sampler(Sampler const&) = delete;
+	Sampler& operator=(Sampler const&) = delete;
+
+	/// Szó futtatásának kezdete.
+	void enter_word(uint32_t symbol) { push(Frame{nullptr, symbol, Frame::Word}); }
+	/// Blokk futtatásának kezdete.
+	void enter_block(SourceLocation const& location) { push(Frame{location.file, location.line, Frame::Block}); }
+	/// A legutóbb elkezdett szó vagy blokk vége.
+	void leave(void) {
+		std::atomic_signal_fence(std::memory_order_release);
+		depth--;
+	}
+
+	/// Az időzítő leállítása és a minták kiírása.
+	/// @returns Sikerült-e a fájlt kiírni.
+	bool write(void);
+
+private:
+	/// Ennyi elemet tárol a hívási veremből (a legbelsőket), mélyebb verem esetén a külsők elvesznek.
+	static constexpr uint32_t MAX_DEPTH = 1024;
+
+	Frame frames[MAX_DEPTH];
+	/// A logikai hívási verem mérete (MAX_DEPTH -nél nagyobb is lehet).
+	volatile uint32_t depth = 0;
+
+	/// A minták: mindegyik egy fejléc, majd a hívási lánc a legkülsőtől kezdve.
+	std::vector<Frame> samples;
+	/// A \c samples felhasznált része, csak a jelzéskezelő írja.
+	volatile size_t used = 0;
+	/// A puffer megtelte miatt elvesztett minták száma.
+	volatile size_t dropped = 0;
+
+	timer_t timer;
+	bool running = false;
+	std::string path;
+
+	void push(Frame f) {
+		frames[depth % MAX_DEPTH] = f;
+		std::atomic_signal_fence(std::memory_order_release);
+		depth++;
+		if (used > samples.size() / 2) grow();
+	}
+
+	/// A mintapuffer bővítése (a jelzést közben letiltja).
+	void grow(void);
+	/// A jelzéskezelő: a hívási verem mentése.
+	void sample(void);
+	static void on_signal(int);
+	/// Egy elem neve a kimenetben.
+	std::string label(Frame const& f) const;
+
+	static Sampler* active;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief Strukturális index implementáció.
+ *
+ * Az osztályozó kernelek 64 bájtonként egy-egy maszkot állítanak elő. A
+ * szóközöket egy 16 elemű táblából keresik ki a bájt alsó 4 bitje alapján
+ * (\c pshufb), és összehasonlítják magával a bájttal, így egy keresés és egy
+ * összehasonlítás elég mind a hat szóköz karakterre. A kernelt futáskor
+ * választjuk ki a processzor képességei alapján.
+ */
+#include <cstring>
+#include <algorithm>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/// Osztályozó kernel: \c blocks darab 64 bájtos blokk maszkjainak kiszámolása.
+typedef void (*Kernel)(const char* p, size_t blocks, uint64_t* space, uint64_t* quote, uint64_t* newline, uint64_t* bang);
+
+static void classify_scalar(const char* p, size_t blocks, uint64_t* space, uint64_t* quote, uint64_t* newline, uint64_t* bang) {
+	for (size_t b = 0; b < blocks; b++, p += 64) {
+		uint64_t s = 0, q = 0, n = 0, x = 0;
+		for (unsigned i = 0; i < 64; i++) {
+			unsigned char c = p[i];
+			s |= (uint64_t)(c == ' ' || (c >= '\t' && c <= '\r')) << i;
+			q |= (uint64_t)(c == '"') << i;
+			n |= (uint64_t)(c == '\n') << i;
+			x |= (uint64_t)(c == '!') << i;
+		}
+		space[b] = s; quote[b] = q; newline[b] = n; bang[b] = x;
+	}
+}
+
+#ifdef SCAN_X86
+__attribute__((target("avx2")))
+static inline uint64_t bits(__m256i m) {
+	return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char* p, size_t blocks, uint64_t* space, uint64_t* quote, uint64_t* newline, uint64_t* bang) {
+	const __m256i table = _mm256_setr_epi8(
+		' ', -1, -1, -1, -1, -1, -1, -1, -1, '\t', '\n', '\v', '\f', '\r', -1, -1,
+		' ', -1, -1, -1, -1, -1, -1, -1, -1, '\t', '\n', '\v', '\f', '\r', -1, -1);
+	const __m256i q = _mm256_set1_epi8('"'), nl = _mm256_set1_epi8('\n'), x = _mm256_set1_epi8('!');
+	for (size_t b = 0; b < blocks; b++, p += 64) {
+		__m256i lo = _mm256_loadu_si256((const __m256i*)p);
+		__m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+		// bytes with the high bit set look up 0, which never equals them
+		space[b] = bits(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(table, lo), lo))
+			| bits(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(table, hi), hi)) << 32;
+		quote[b] = bits(_mm256_cmpeq_epi8(lo, q)) | bits(_mm256_cmpeq_epi8(hi, q)) << 32;
+		newline[b] = bits(_mm256_cmpeq_epi8(lo, nl)) | bits(_mm256_cmpeq_epi8(hi, nl)) << 32;
+		bang[b] = bits(_mm256_cmpeq_epi8(lo, x)) | bits(_mm256_cmpeq_epi8(hi, x)) << 32;
+	}
+}
+
+__attribute__((target("sse4.2")))
+static void classify_sse(const char* p, size_t blocks, uint64_t* space, uint64_t* quote, uint64_t* newline, uint64_t* bang) {
+	const __m128i table = _mm_setr_epi8(' ', -1, -1, -1, -1, -1, -1, -1, -1, '\t', '\n', '\v', '\f', '\r', -1, -1);
+	const __m128i q = _mm_set1_epi8('"'), nl = _mm_set1_epi8('\n'), x = _mm_set1_epi8('!');
+	for (size_t b = 0; b < blocks; b++, p += 64) {
+		uint64_t s = 0, qm = 0, n = 0, xm = 0;
+		for (unsigned i = 0; i < 4; i++) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+			s |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_shuffle_epi8(table, v), v)) << 16 * i;
+			qm |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)) << 16 * i;
+			n |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)) << 16 * i;
+			xm |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, x)) << 16 * i;
+		}
+		space[b] = s; quote[b] = qm; newline[b] = n; bang[b] = xm;
+	}
+}
+#endif
+
+static Kernel select_kernel(const char** name) {
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		*name = "avx2";
+		return classify_avx2;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		*name = "sse4.2";
+		return classify_sse;
+	}
+#endif
+	*name = "scalar";
+	return classify_scalar;
+}
+
+/// A kiválasztott kernel és a neve.
+struct Selected {
+	const char* name;
+	Kernel kernel;
+	Selected(void) { kernel = select_kernel(&name); }
+};
+
+static Selected const& selected(void) {
+	static const Selected s;
+	return s;
+}
+
+const char* StructuralIndex::kernel_name(void) {
+	return selected().name;
+}
+
+StructuralIndex::StructuralIndex(const char* data, size_t size): data(data), size(size), window(SIZE_MAX) {}
+
+void StructuralIndex::load(size_t block) {
+	window = block - block % WINDOW;
+	size_t blocks = std::min(WINDOW, (size + 63) / 64 - window);
+	size_t full = std::min(blocks, (size - window * 64) / 64);
+	Kernel kernel = selected().kernel;
+	kernel(data + window * 64, full, masks[Space], masks[Quote], masks[Newline], masks[Bang]);
+	if (full < blocks) {
+		// the last, partial block is padded with spaces so the kernel may read 64 bytes
+		char tail[64];
+		size_t rest = size - (window + full) * 64;
+		memset(tail, ' ', sizeof tail);
+		memcpy(tail, data + (window + full) * 64, rest);
+		kernel(tail, 1, masks[Space] + full, masks[Quote] + full, masks[Newline] + full, masks[Bang] + full);
+	}
+}
+
+uint64_t StructuralIndex::mask(Class c, size_t block) {
+	if (window == SIZE_MAX || block < window || block >= window + WINDOW) load(block);
+	return masks[c][block - window];
+}
+
+size_t StructuralIndex::find(Class c, size_t from, bool match) {
+	if (from >= size) return size;
+	uint64_t flip = match ? 0 : ~0ull;
+	size_t block = from / 64;
+	uint64_t m = (mask(c, block) ^ flip) & (~0ull << from % 64);
+	while (!m) {
+		if (++block * 64 >= size) return size;
+		m = mask(c, block) ^ flip;
+	}
+	return std::min(size, block * 64 + __builtin_ctzll(m));
+}
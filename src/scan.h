@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @brief A forrás bájtjainak osztályozása (strukturális index) a tokenizáláshoz.
+ */
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstdint>
+#include <cstddef>
+
+/// A forrás bájtosztályainak bitképe.
+/**
+ * A forrást 64 bájtos blokkokban osztályozza (SIMD utasításokkal, ha a
+ * processzor támogatja), blokkonként egy-egy 64 bites maszkot készítve.
+ * A tokenizáló ezekben keresi a következő határt, így nem kell minden bájtot
+ * egyesével megnéznie. A maszkokat egyszerre csak egy ablakra számolja ki,
+ * így a memóriaigény nem függ a forrás méretétől.
+ */
+class StructuralIndex {
+public:
+	/// A megkülönböztetett bájtosztályok.
+	enum Class {
+		/// Szóköz jellegű karakter (mint az \c isspace a "C" locale-ban).
+		Space,
+		/// \c " karakter.
+		Quote,
+		/// Sorvége (\c \\n).
+		Newline,
+		/// \c ! karakter (kommentet kezdhet).
+		Bang,
+		CLASS_COUNT
+	};
+
+	/// @param data A forrás, az index élettartama alatt nem változhat.
+	/// @param size A forrás mérete.
+	StructuralIndex(const char* data, size_t size);
+
+	/// Következő adott osztályú (vagy nem olyan osztályú) bájt keresése.
+	/**
+	 * @param c A keresett osztály.
+	 * @param from Innen kezdve keres (ezt is beleértve).
+	 * @param match Ha hamis, az első nem \c c osztályú bájtot keresi.
+	 * @returns A bájt pozíciója, vagy a forrás mérete, ha nincs ilyen.
+	 */
+	size_t find(Class c, size_t from, bool match = true);
+
+	/// Az osztályozáshoz használt utasításkészlet neve (\c "avx2", \c "sse4.2" vagy \c "scalar").
+	static const char* kernel_name(void);
+
+private:
+	/// Ennyi blokk maszkjait számolja ki egyszerre.
+	static constexpr size_t WINDOW = 1024;
+
+	const char* data;
+	size_t size;
+	/// Az ablak első blokkjának sorszáma.
+	size_t window;
+	uint64_t masks[CLASS_COUNT][WINDOW];
+
+	/// Az adott blokk maszkja (ha kell, az ablakot odébb tolja).
+	uint64_t mask(Class c, size_t block);
+	/// A blokkot tartalmazó ablak maszkjainak kiszámolása.
+	void load(size_t block);
+};
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * @file
+ * @brief Szerver mód implementáció.
+ *
+ * Minden munkaszál maga hívja az \c accept -et a közös socketen, és a kapott
+ * kapcsolat összes kérését kiszolgálja. A munkaszálak saját veremmel és
+ * szótárral dolgoznak, így a kérések futtatása nem igényel zárolást.
+ */
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <unordered_set>
+
+#include "server.h"
+#include "tokenizer.h"
+#include "parser.h"
+#include "memory.h"
+
+/// Pontosan \c n bájt olvasása.
+/// @returns Hamis, ha a kapcsolat előbb véget ért, vagy hiba történt.
+static bool read_full(int fd, void* data, size_t n) {
+	char* p = (char*)data;
+	while (n > 0) {
+		ssize_t r = recv(fd, p, n, 0);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return false;
+		p += r; n -= r;
+	}
+	return true;
+}
+
+/// Pontosan \c n bájt írása.
+/// @returns Hamis, ha hiba történt (pl. a másik fél bezárta a kapcsolatot).
+static bool write_full(int fd, const void* data, size_t n) {
+	const char* p = (const char*)data;
+	while (n > 0) {
+		// a closed connection must not kill the process with SIGPIPE
+		ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+		if (r < 0 && errno == EINTR) continue;
+		if (r < 0) return false;
+		p += r; n -= r;
+	}
+	return true;
+}
+
+/// Unix socket cím kitöltése.
+/// @returns Hamis, ha túl hosszú az elérési út.
+static bool socket_address(const char* path, sockaddr_un& addr) {
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof addr.sun_path) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	return true;
+}
+
+/// Egy munkaszál interpretere.
+class Worker {
+	Dictionary const& prelude;
+	Dictionary words;
+	Stack stack;
+	std::ostringstream out;
+public:
+	/// @param p Az előtag szótára, minden kérés ennek másolatával fut.
+	Worker(Dictionary const& p): prelude(p), words(p) {}
+
+	/// Egy kérés futtatása, utána a verem és a szótár visszaáll.
+	/// @returns A futás eredménye.
+	Error run(std::string const& source, RequestHeader const& header) {
+		out.str("");
+		out.clear();
+
+		std::optional<std::vector<Token*>> tokens = tokenize(std::string_view(source));
+		if (!tokens) return SYNTAX_ERROR;
+		std::vector<Token*>::const_iterator begin = tokens->cbegin();
+		std::optional<std::vector<Object*>> code = parse(begin, tokens->cend());
+
+		Error e = SYNTAX_ERROR;
+		if (code) {
+			Environment env{stack, words, out};
+			// a task would outlive the request and write into the next request's output
+			env.tasks = false;
+			if (header.time_limit_us)
+				env.deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(header.time_limit_us);
+			env.memory_limit = header.memory_limit != 0;
+			set_memory_limit(header.memory_limit);
+			try {
+				e = interpret(*code, env);
+				// the last word may have exceeded the limit
+				if (e == SUCCESS && memory_exceeded()) e = OUT_OF_MEMORY;
+			} catch (std::bad_alloc const&) {
+				// only if malloc itself fails, the limit does not throw
+				e = OUT_OF_MEMORY;
+			}
+			set_memory_limit(0);
+			for (Object* o: *code) delete o;
+		}
+		for (Token* t: *tokens) delete t;
+		reset();
+		return e;
+	}
+
+	/// A verem és a szótár visszaállítása (egy megszakadt kérés után is).
+	void reset(void) {
+		for (Object* o: stack) delete o;
+		stack.clear();
+		// copying the dictionary is only needed if the program defined words
+		if (words.revision() != prelude.revision()) words = prelude;
+	}
+
+	/// Az utolsó kérés kimenete.
+	std::string output(void) const { return out.str(); }
+};
+
+/// A munkaszálak közös állapota.
+class Server {
+	int listener;
+	Dictionary const& prelude;
+	std::mutex lock;
+	/// A kiszolgálás alatt álló kapcsolatok, leállításkor ezeket is le kell zárni.
+	std::unordered_set<int> clients;
+	bool stopping = false;
+
+	/// Egy kapcsolat összes kérésének kiszolgálása.
+	/// @note Hiba esetén (pl. elfogyott a memória) csak ezt a kapcsolatot bontja.
+	void connection(int fd, Worker& w) noexcept {
+		RequestHeader header;
+		std::string source;
+		try {
+			while (read_full(fd, &header, sizeof header)) {
+				if (header.length > MAX_REQUEST_LENGTH || (header.memory_limit && header.length > header.memory_limit)) {
+					// the source is not read, so the connection cannot be continued
+					ResponseHeader response{(int32_t)OUT_OF_MEMORY, 0, 0};
+					write_full(fd, &response, sizeof response);
+					return;
+				}
+				source.resize(header.length);
+				if (!read_full(fd, source.data(), source.size())) return;
+				Error e = w.run(source, header);
+
+				std::string output = w.output();
+				ResponseHeader response{(int32_t)e, 0, output.size()};
+				std::string reply((const char*)&response, sizeof response);
+				reply += output;
+				if (!write_full(fd, reply.data(), reply.size())) return;
+			}
+		} catch (std::exception const&) {
+			// only this connection is dropped, the worker serves the next one
+			try {
+				w.reset();
+			} catch (std::exception const&) {}
+		}
+	}
+public:
+	Server(int fd, Dictionary const& p): listener(fd), prelude(p) {}
+
+	/// Munkaszál: kapcsolatok fogadása a leállításig.
+	void worker(void) {
+		Worker w(prelude);
+		for (;;) {
+			int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno == EINTR || errno == ECONNABORTED) continue;
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (stopping) {
+					close(fd);
+					return;
+				}
+				clients.insert(fd);
+			}
+			connection(fd, w);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				clients.erase(fd);
+			}
+			close(fd);
+		}
+	}
+
+	/// A várakozó és a kiszolgáló munkaszálak leállítása.
+	/// @note A futó kéréseket nem szakítja meg, csak a befejezésük után állnak le.
+	void stop(void) {
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		shutdown(listener, SHUT_RDWR);
+		for (int fd: clients) shutdown(fd, SHUT_RDWR);
+	}
+};
+
+bool serve(const char* socket_path, Dictionary const& prelude, unsigned workers) {
+	sockaddr_un addr;
+	if (!socket_address(socket_path, addr)) return false;
+
+	// a socket left behind by a previous server can be replaced, other files not
+	struct stat st;
+	if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socket_path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return false;
+	if (bind(fd, (sockaddr*)&addr, sizeof addr) < 0 || listen(fd, SOMAXCONN) < 0) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return false;
+	}
+
+	// the workers copy the prelude's bodies concurrently
+	prelude.freeze();
+
+	// the signals are waited for on this thread, the workers inherit the mask
+	sigset_t signals, old;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, &old);
+
+	Server server(fd, prelude);
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < workers; i++)
+		threads.emplace_back([&server](void) { server.worker(); });
+
+	int sig;
+	while (sigwait(&signals, &sig) != 0) {}
+	server.stop();
+	for (std::thread& t: threads) t.join();
+
+	close(fd);
+	unlink(socket_path);
+	pthread_sigmask(SIG_SETMASK, &old, nullptr);
+	return true;
+}
+
+bool run_remote(const char* socket_path, std::string const& source, RequestHeader header, std::string& output, Error& error) {
+	sockaddr_un addr;
+	if (!socket_address(socket_path, addr)) return false;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return false;
+
+	header.length = source.size();
+	ResponseHeader response;
+	errno = 0;
+	bool ok = connect(fd, (sockaddr*)&addr, sizeof addr) == 0
+		&& write_full(fd, &header, sizeof header)
+		&& write_full(fd, source.data(), source.size())
+		&& read_full(fd, &response, sizeof response);
+	if (ok) {
+		output.resize(response.length);
+		ok = read_full(fd, output.data(), output.size());
+		error = (Error)response.error;
+	}
+	// a connection closed early is not an errno error
+	if (!ok && errno == 0) errno = ECONNRESET;
+	int err = errno;
+	close(fd);
+	errno = err;
+	return ok;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @brief Szerver mód: előre betöltött interpreterek egy Unix socketen.
+ *
+ * A szerver induláskor egyszer futtatja le a közös előtagot (prelude), majd
+ * minden munkaszál ennek a szótárával indul. A kliensek programokat küldenek,
+ * a szerver a program kimenetével és hibakódjával válaszol. Minden kérés üres
+ * veremmel és az előtag szótárával fut, és nem indíthat párhuzamos feladatot
+ * (\c spawn), mert az a válasz után is futna.
+ *
+ * A protokoll (a gép bájtsorrendjével): a kliens kérésenként egy RequestHeader
+ * -t, majd a program forrását küldi; a szerver egy ResponseHeader -t, majd a
+ * program kimenetét. Egy kapcsolaton egymás után több kérés is küldhető.
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdint>
+#include <string>
+
+#include "interpreter.h"
+
+/// A program forrásának legnagyobb hossza bájtokban.
+static constexpr uint64_t MAX_REQUEST_LENGTH = (uint64_t)16 << 20;
+
+/// Egy kérés fejléce.
+struct RequestHeader {
+	/// A forrás hossza bájtokban, legfeljebb \c MAX_REQUEST_LENGTH és \c memory_limit.
+	/// Hosszabb forrásra a szerver \c OUT_OF_MEMORY hibával válaszol, és bontja a kapcsolatot.
+	uint64_t length;
+	/// Legfeljebb ennyi ideig futhat (mikroszekundum), 0 esetén nincs korlát.
+	uint64_t time_limit_us;
+	/// Legfeljebb ennyi memóriát foglalhat (bájt), 0 esetén nincs korlát.
+	uint64_t memory_limit;
+};
+
+/// Egy válasz fejléce.
+struct ResponseHeader {
+	/// A futás eredménye (Error).
+	int32_t error;
+	uint32_t reserved;
+	/// A kimenet hossza bájtokban.
+	uint64_t length;
+};
+
+/// Kérések kiszolgálása, amíg \c SIGINT vagy \c SIGTERM nem érkezik.
+/**
+ * @param socket_path A létrehozandó socket elérési útja.
+ * @param prelude A futtatott előtag szótára, a munkaszálak ennek másolatával indulnak.
+ * @param workers A munkaszálak (egyszerre kiszolgált kapcsolatok) száma.
+ * @returns Sikerült-e a socketet létrehozni (ha nem, \c errno beállítva).
+ */
+bool serve(const char* socket_path, Dictionary const& prelude, unsigned workers);
+
+/// Program futtatása egy szerveren.
+/**
+ * @param socket_path A szerver socketje.
+ * @param source A program forrása.
+ * @param header A kérés korlátai, a \c length -et kitölti.
+ * @param[out] output A program kimenete.
+ * @param[out] error A futás eredménye.
+ * @returns Sikerült-e a kommunikáció (ha nem, \c errno beállítva).
+ */
+bool run_remote(const char* socket_path, std::string const& source, RequestHeader header, std::string& output, Error& error);
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file
+ * @brief Radix sort implementáció.
+ *
+ * Minden számot egy előjel nélküli, 64-bites kulcsra képzünk úgy, hogy a kulcsok
+ * sorrendje megegyezzen a számokéval, és ezeket rendezzük 8-bites számjegyenként.
+ * Nagy bemenetnél a darabokat külön szálakon rendezzük, majd összefésüljük.
+ */
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include "sort.h"
+
+using Key = uint64_t;
+
+static constexpr Key SIGN = 1ull << 63;
+
+static inline Key int_key(int64_t x) { return (Key)x ^ SIGN; }
+static inline int64_t key_int(Key k) { return (int64_t)(k ^ SIGN); }
+
+static inline Key float_key(double x) {
+	Key bits; memcpy(&bits, &x, sizeof bits);
+	// negative numbers are ordered backwards, positive ones after them
+	return (bits & SIGN) ? ~bits : bits | SIGN;
+}
+static inline double key_float(Key k) {
+	Key bits = (k & SIGN) ? k & ~SIGN : ~k;
+	double x; memcpy(&x, &bits, sizeof x);
+	return x;
+}
+
+/// Ennél rövidebb bemenetet összehasonlító rendezéssel rendezünk.
+static constexpr size_t RADIX_THRESHOLD = 256;
+/// Ennél rövidebb bemenetet egy szálon rendezünk.
+static constexpr size_t PARALLEL_THRESHOLD = 1 << 20;
+
+/// Kulcsok (és indexek) rendezése egy szálon.
+/**
+ * @param keys, idx A rendezendő kulcsok és a hozzájuk tartozó indexek (\c idx lehet \c nullptr).
+ * @param tmp_keys, tmp_idx Legalább \c n méretű segédtömbök.
+ */
+static void radix_sort(Key* keys, int64_t* idx, size_t n, Key* tmp_keys, int64_t* tmp_idx) {
+	if (n < RADIX_THRESHOLD) {
+		if (!idx) {
+			std::sort(keys, keys + n);
+			return;
+		}
+		// stable insertion sort, carrying the indices along
+		for (size_t i = 1; i < n; i++) {
+			Key k = keys[i]; int64_t x = idx[i];
+			size_t j = i;
+			for (; j > 0 && keys[j - 1] > k; j--) {
+				keys[j] = keys[j - 1]; idx[j] = idx[j - 1];
+			}
+			keys[j] = k; idx[j] = x;
+		}
+		return;
+	}
+
+	// histograms of all the digits in a single pass
+	std::vector<size_t> counts(8 * 256);
+	for (size_t i = 0; i < n; i++)
+		for (unsigned d = 0; d < 8; d++)
+			counts[d * 256 + ((keys[i] >> (8 * d)) & 0xff)]++;
+
+	Key* src_k = keys; Key* dst_k = tmp_keys;
+	int64_t* src_i = idx; int64_t* dst_i = tmp_idx;
+	for (unsigned d = 0; d < 8; d++) {
+		size_t* count = &counts[d * 256];
+		unsigned shift = 8 * d;
+		// every key has the same digit, the pass would not move anything
+		if (count[(src_k[0] >> shift) & 0xff] == n) continue;
+
+		size_t offset[256], sum = 0;
+		for (unsigned b = 0; b < 256; b++) {
+			offset[b] = sum; sum += count[b];
+		}
+		if (idx) {
+			for (size_t i = 0; i < n; i++) {
+				size_t pos = offset[(src_k[i] >> shift) & 0xff]++;
+				dst_k[pos] = src_k[i]; dst_i[pos] = src_i[i];
+			}
+			std::swap(src_i, dst_i);
+		} else {
+			for (size_t i = 0; i < n; i++)
+				dst_k[offset[(src_k[i] >> shift) & 0xff]++] = src_k[i];
+		}
+		std::swap(src_k, dst_k);
+	}
+
+	// odd number of passes: the result is in the temporary arrays
+	if (src_k != keys) {
+		memcpy(keys, src_k, n * sizeof(Key));
+		if (idx) memcpy(idx, src_i, n * sizeof(int64_t));
+	}
+}
+
+/// Két szomszédos rendezett darab stabil összefésülése.
+static void merge_runs(const Key* keys, const int64_t* idx, size_t begin, size_t mid, size_t end,
+						Key* out_keys, int64_t* out_idx) {
+	size_t a = begin, b = mid, o = begin;
+	while (a < mid && b < end) {
+		// take from the left run on ties to stay stable
+		size_t from = (keys[b] < keys[a]) ? b++ : a++;
+		out_keys[o] = keys[from];
+		if (idx) out_idx[o] = idx[from];
+		o++;
+	}
+	for (; a < mid; a++, o++) {
+		out_keys[o] = keys[a];
+		if (idx) out_idx[o] = idx[a];
+	}
+	for (; b < end; b++, o++) {
+		out_keys[o] = keys[b];
+		if (idx) out_idx[o] = idx[b];
+	}
+}
+
+/// Kulcsok (és indexek) rendezése, nagy bemenet esetén több szálon.
+static void sort_keys(Key* keys, int64_t* idx, size_t n) {
+	std::vector<Key> tmp_keys(n);
+	std::vector<int64_t> tmp_idx(idx ? n : 0);
+
+	unsigned threads = std::thread::hardware_concurrency();
+	if (n < PARALLEL_THRESHOLD || threads < 2) {
+		radix_sort(keys, idx, n, tmp_keys.data(), tmp_idx.data());
+		return;
+	}
+	threads = (unsigned)std::min<size_t>(threads, n / (PARALLEL_THRESHOLD / 4));
+
+	// sort the chunks in parallel
+	std::vector<size_t> bounds(threads + 1);
+	for (unsigned t = 0; t <= threads; t++)
+		bounds[t] = n * t / threads;
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; t++)
+		workers.emplace_back([&, t] {
+			size_t b = bounds[t];
+			radix_sort(keys + b, idx ? idx + b : nullptr, bounds[t + 1] - b,
+						tmp_keys.data() + b, idx ? tmp_idx.data() + b : nullptr);
+		});
+	for (std::thread& w: workers) w.join();
+
+	// merge neighbouring runs pairwise, every pair on its own thread
+	Key* src_k = keys; Key* dst_k = tmp_keys.data();
+	int64_t* src_i = idx; int64_t* dst_i = idx ? tmp_idx.data() : nullptr;
+	while (bounds.size() > 2) {
+		std::vector<size_t> merged;
+		workers.clear();
+		size_t r = 0;
+		for (; r + 2 < bounds.size(); r += 2) {
+			size_t b = bounds[r], m = bounds[r + 1], e = bounds[r + 2];
+			workers.emplace_back([=] { merge_runs(src_k, src_i, b, m, e, dst_k, dst_i); });
+			merged.push_back(b);
+		}
+		// an odd run out is copied as is
+		if (r + 1 < bounds.size()) {
+			size_t b = bounds[r], e = bounds[r + 1];
+			memcpy(dst_k + b, src_k + b, (e - b) * sizeof(Key));
+			if (idx) memcpy(dst_i + b, src_i + b, (e - b) * sizeof(int64_t));
+			merged.push_back(b);
+		}
+		merged.push_back(n);
+		for (std::thread& w: workers) w.join();
+
+		bounds = std::move(merged);
+		std::swap(src_k, dst_k); std::swap(src_i, dst_i);
+	}
+
+	if (src_k != keys) {
+		memcpy(keys, src_k, n * sizeof(Key));
+		if (idx) memcpy(idx, src_i, n * sizeof(int64_t));
+	}
+}
+
+void sort_ints(int64_t* data, size_t n) {
+	// signed and unsigned integers may alias, the keys can be made in place
+	Key* keys = (Key*)data;
+	for (size_t i = 0; i < n; i++) keys[i] = int_key(data[i]);
+	sort_keys(keys, nullptr, n);
+	for (size_t i = 0; i < n; i++) data[i] = key_int(keys[i]);
+}
+
+void sort_floats(double* data, size_t n) {
+	std::vector<Key> keys(n);
+	for (size_t i = 0; i < n; i++) keys[i] = float_key(data[i]);
+	sort_keys(keys.data(), nullptr, n);
+	for (size_t i = 0; i < n; i++) data[i] = key_float(keys[i]);
+}
+
+void grade_ints(const int64_t* data, size_t n, int64_t* perm) {
+	std::vector<Key> keys(n);
+	for (size_t i = 0; i < n; i++) {
+		keys[i] = int_key(data[i]); perm[i] = (int64_t)i;
+	}
+	sort_keys(keys.data(), perm, n);
+}
+
+void grade_floats(const double* data, size_t n, int64_t* perm) {
+	std::vector<Key> keys(n);
+	for (size_t i = 0; i < n; i++) {
+		keys[i] = float_key(data[i]); perm[i] = (int64_t)i;
+	}
+	sort_keys(keys.data(), perm, n);
+}
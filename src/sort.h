@@ -0,0 +1,36 @@
+/**
+ * @file
+ * @brief Számok rendezése (radix sort).
+ */
+#ifndef SORT_H
+#define SORT_H
+
+#include <cstdint>
+#include <cstddef>
+
+/// Egészek rendezése helyben.
+/**
+ * LSD radix sort, nagy bemenet esetén több szálon.
+ * @param data A rendezendő elemek.
+ * @param n Az elemek száma.
+ */
+void sort_ints(int64_t* data, size_t n);
+
+/// Valósak rendezése helyben.
+/// @copydetails sort_ints
+void sort_floats(double* data, size_t n);
+
+/// Egészek rendező permutációja (grade).
+/**
+ * Stabil: egyenlő elemek közül a kisebb indexű van előrébb.
+ * @param data A rendezendő elemek, nem változnak.
+ * @param n Az elemek száma.
+ * @param[out] perm Az eredmény: \c perm[i] a rendezett sorozat i. elemének indexe.
+ */
+void grade_ints(const int64_t* data, size_t n, int64_t* perm);
+
+/// Valósak rendező permutációja (grade).
+/// @copydetails grade_ints
+void grade_floats(const double* data, size_t n, int64_t* perm);
+
+#endif
@@ -0,0 +1,19 @@
+/**
+ * @file
+ * @brief Szavak azonosítóinak implementációja.
+ */
+#include "symbols.h"
+#include "interpreter.h"
+
+SymbolTable::SymbolTable(void) {
+	for (std::string_view name: builtin_names()) intern(std::string(name));
+}
+
+uint32_t SymbolTable::intern(std::string const& name) {
+	auto it = ids.find(name);
+	if (it != ids.end()) return it->second;
+	uint32_t id = (uint32_t)names.size();
+	ids.emplace(name, id);
+	names.push_back(name);
+	return id;
+}
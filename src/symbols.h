@@ -0,0 +1,36 @@
+/**
+ * @file
+ * @brief Szavak azonosítói a nyomkövetéshez és a profilozáshoz.
+ */
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// Szavak nevei és azonosítói.
+/**
+ * A beépített szavak azonosítója a builtin_words -beli indexük (ezt a futtatás
+ * úgyis kiszámolja), a többi szó az első előfordulásakor kap azonosítót.
+ */
+class SymbolTable {
+	std::vector<std::string> names;
+	std::unordered_map<std::string, uint32_t> ids;
+public:
+	/// A beépített szavakkal (builtin_names()) kezdődő tábla.
+	SymbolTable(void);
+
+	/// Szó azonosítója, ha még nincs, újat ad neki.
+	uint32_t intern(std::string const& name);
+
+	/// Az azonosítók száma.
+	size_t size(void) const { return names.size(); }
+
+	/// Az azonosítóhoz tartozó név.
+	std::string const& name(uint32_t id) const { return names[id]; }
+};
+
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file
+ * @brief Feladatok és csatornák implementáció.
+ */
+#include <algorithm>
+#include <deque>
+#include <system_error>
+#include <thread>
+
+#include "tasks.h"
+
+/// A tétlen szál ennyi idő után kilép.
+static constexpr std::chrono::seconds IDLE_TIMEOUT{10};
+/// Ennyiszer próbálkozik újra (a processzort átengedve), mielőtt várakozni kezd.
+static constexpr int SPIN_ROUNDS = 16;
+
+/// Egy várakozás (\c send, \c recv, \c join) ideje alatt él, lásd start_task().
+struct Blocked {
+	Blocked(void);
+	Blocked(Blocked const&) = delete;
+	Blocked& operator=(Blocked const&) = delete;
+	~Blocked(void);
+};
+
+void Task::finish(Error e, std::vector<Object*> stack) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		error = e;
+		result = std::move(stack);
+		finished = true;
+	}
+	done.notify_all();
+}
+
+Error Task::join(std::vector<Object*>& out, Deadline const& deadline) {
+	std::optional<Blocked> blocked;
+	std::unique_lock<std::mutex> guard(lock);
+	while (!finished) {
+		if (!blocked) blocked.emplace();
+		if (!deadline) done.wait(guard);
+		else if (done.wait_until(guard, *deadline) == std::cv_status::timeout && !finished) return TIMEOUT;
+	}
+	if (joined) return INCORRECT_VALUE;
+	joined = true;
+	if (error == SUCCESS) out.insert(out.end(), result.begin(), result.end());
+	else for (Object* o: result) delete o;
+	result.clear();
+	return error;
+}
+
+Task::~Task(void) {
+	for (Object* o: result) delete o;
+}
+
+Channel::Channel(size_t capacity) {
+	size_t size = 2;
+	while (size < capacity) size *= 2;
+	cells = std::make_unique<Cell[]>(size);
+	for (size_t i = 0; i < size; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+	mask = size - 1;
+}
+
+Channel::~Channel(void) {
+	Object* o;
+	while (try_receive(o)) delete o;
+}
+
+bool Channel::try_send(Object* o) {
+	size_t pos = head.load(std::memory_order_relaxed);
+	for (;;) {
+		Cell& cell = cells[pos & mask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		ptrdiff_t diff = (ptrdiff_t)(sequence - pos);
+		if (diff == 0) {
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				cell.value = o;
+				cell.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			// the cell has not been read since the previous round: full
+			return false;
+		} else {
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool Channel::try_receive(Object*& o) {
+	size_t pos = tail.load(std::memory_order_relaxed);
+	for (;;) {
+		Cell& cell = cells[pos & mask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		ptrdiff_t diff = (ptrdiff_t)(sequence - (pos + 1));
+		if (diff == 0) {
+			if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				o = cell.value;
+				// free for the writer of the next round
+				cell.sequence.store(pos + mask + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			// the cell has not been written in this round: empty
+			return false;
+		} else {
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void Channel::wake(void) {
+	// either this sees the waiter, or the waiter's retry sees the change
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting.load(std::memory_order_relaxed) == 0) return;
+	std::lock_guard<std::mutex> guard(lock);
+	changed.notify_all();
+}
+
+/// Várakozás, amíg a művelet sikerül.
+/**
+ * @tparam F <tt>bool()</tt>, a művelet egy (nem váró) kísérlete.
+ * @returns \c TIMEOUT, ha a határidő lejárt.
+ */
+template<typename F>
+static Error retry_until(F attempt, std::mutex& lock, std::condition_variable& changed, std::atomic<size_t>& waiting, Deadline const& deadline) {
+	for (int i = 0; i < SPIN_ROUNDS; i++) {
+		if (attempt()) return SUCCESS;
+		std::this_thread::yield();
+	}
+	Blocked blocked;
+	std::unique_lock<std::mutex> guard(lock);
+	waiting.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	Error e = SUCCESS;
+	while (!attempt()) {
+		if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+			e = TIMEOUT;
+			break;
+		}
+		if (deadline) changed.wait_until(guard, *deadline);
+		else changed.wait(guard);
+	}
+	waiting.fetch_sub(1, std::memory_order_relaxed);
+	return e;
+}
+
+Error Channel::send(Object* o, Deadline const& deadline) {
+	Error e = retry_until([&]() { return try_send(o); }, lock, changed, waiting, deadline);
+	if (e == SUCCESS) wake();
+	return e;
+}
+
+Error Channel::receive(Object*& o, Deadline const& deadline) {
+	Error e = retry_until([&]() { return try_receive(o); }, lock, changed, waiting, deadline);
+	if (e == SUCCESS) wake();
+	return e;
+}
+
+/// A feladatokat futtató szálak.
+struct WorkerPool {
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<std::function<void()>> jobs;
+	/// Ennyi szál futtathat egyszerre (a várakozókon kívül).
+	const size_t max_running = std::max(1u, std::thread::hardware_concurrency());
+	/// Az összes szál száma.
+	size_t threads = 0;
+	/// A munkára váró szálak száma.
+	size_t idle = 0;
+	/// A csatornán vagy feladatra váró szálak száma.
+	size_t blocked = 0;
+	/// A még be nem fejezett függvények száma.
+	size_t pending = 0;
+
+	/// Új szál indítása, ha van várakozó munka, amelyet nem vesz fel tétlen szál, és a futó
+	/// szálak száma a korlát alatt van. A zárolást a hívó tartja.
+	/// @returns Hamis, ha a szálat nem sikerült elindítani.
+	bool grow(void);
+};
+
+static WorkerPool& workers(void) {
+	// never destroyed, the threads are detached and may outlive main()
+	static WorkerPool* p = new WorkerPool();
+	return *p;
+}
+
+/// A készlet egy szála-e a hívó.
+static thread_local bool in_pool = false;
+
+Blocked::Blocked(void) {
+	if (!in_pool) return;
+	WorkerPool& p = workers();
+	std::lock_guard<std::mutex> guard(p.lock);
+	p.blocked++;
+	// the queued job may be the one this thread waits for; if no thread starts, a running one takes it later
+	p.grow();
+}
+
+Blocked::~Blocked(void) {
+	if (!in_pool) return;
+	WorkerPool& p = workers();
+	std::lock_guard<std::mutex> guard(p.lock);
+	p.blocked--;
+}
+
+/// Egy szál a készletben: munkát futtat, amíg túl sokáig nem tétlen.
+static void worker(void) {
+	in_pool = true;
+	WorkerPool& p = workers();
+	std::unique_lock<std::mutex> guard(p.lock);
+	for (;;) {
+		if (p.jobs.empty()) {
+			p.idle++;
+			bool woken = p.wake.wait_for(guard, IDLE_TIMEOUT, [&]() { return !p.jobs.empty(); });
+			p.idle--;
+			if (!woken) {
+				p.threads--;
+				return;
+			}
+		}
+		std::function<void()> job = std::move(p.jobs.front());
+		p.jobs.pop_front();
+		guard.unlock();
+		job();
+		// the captured objects are released outside the lock
+		job = nullptr;
+		guard.lock();
+		p.pending--;
+	}
+}
+
+bool WorkerPool::grow(void) {
+	// every idle thread takes one job
+	if (jobs.size() <= idle || threads - idle - blocked >= max_running) return true;
+	try {
+		std::thread(worker).detach();
+	} catch (std::system_error const&) {
+		return false;
+	}
+	threads++;
+	return true;
+}
+
+Error start_task(std::function<void()> job) {
+	WorkerPool& p = workers();
+	std::unique_lock<std::mutex> guard(p.lock);
+	p.jobs.push_back(std::move(job));
+	p.pending++;
+	if (p.jobs.size() <= p.idle) p.wake.notify_one();
+	else if (!p.grow() && p.threads == p.idle + p.blocked) {
+		// no thread could start, and none is running that would take the job later
+		job = std::move(p.jobs.back());
+		p.jobs.pop_back();
+		p.pending--;
+		guard.unlock();
+		return OUT_OF_MEMORY;
+	}
+	return SUCCESS;
+}
+
+bool tasks_running(void) {
+	WorkerPool& p = workers();
+	std::lock_guard<std::mutex> guard(p.lock);
+	return p.pending > 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file
+ * @brief Párhuzamosan futó feladatok (\c spawn) és a köztük lévő csatornák (\c chan).
+ *
+ * A feladatok egy közös szálkészleten futnak, egyszerre legfeljebb annyi
+ * szálon, ahány processzor van; a többi feladat sorban vár. Egy csatornán vagy
+ * feladatra várakozó szál nem számít bele, helyette új szál indulhat, így egy
+ * többlépcsős feldolgozás (pipeline) nem akad el, ha minden lépcsője egyszerre
+ * várakozik. A sokáig tétlen szálak kilépnek.
+ *
+ * A csatornák az objektumokat nem másolják, csak a mutatójukat adják át egy
+ * zárolás nélküli, korlátos körpufferen (Vyukov-féle MPMC sor). Zárolást
+ * csak az várakozás használ, ha a puffer tele vagy üres.
+ */
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "interpreter.h"
+
+/// Határidő, lásd Environment::deadline.
+using Deadline = std::optional<std::chrono::steady_clock::time_point>;
+
+/// Egy párhuzamosan futó feladat eredménye.
+class Task {
+	std::mutex lock;
+	std::condition_variable done;
+	bool finished = false;
+	bool joined = false;
+	Error error = SUCCESS;
+	std::vector<Object*> result;
+public:
+	Task(void) = default;
+	Task(Task const&) = delete;
+	Task& operator=(Task const&) = delete;
+
+	/// A feladat befejezése (a feladatot futtató szál hívja).
+	/// @param e A futás hibája.
+	/// @param stack A feladat vermén maradt objektumok, ezután a feladat birtokolja őket.
+	void finish(Error e, std::vector<Object*> stack);
+
+	/// Várakozás a feladat befejezésére.
+	/**
+	 * @param[out] out Ide kerülnek a feladat vermén maradt objektumok (hiba esetén semmi).
+	 * @param deadline Ha meg van adva, ekkor \c TIMEOUT hibával feladja a várakozást.
+	 * @returns A feladat hibája, \c INCORRECT_VALUE, ha már bevárták.
+	 */
+	Error join(std::vector<Object*>& out, Deadline const& deadline);
+
+	~Task(void);
+};
+
+/// Korlátos, több író és olvasó által használható csatorna.
+class Channel {
+	/// A puffer egy eleme.
+	struct Cell {
+		/// Az írás és az olvasás sorszáma alapján jelzi, hogy a cella szabad vagy foglalt.
+		std::atomic<size_t> sequence;
+		Object* value;
+	};
+
+	/// Hamis megosztás (false sharing) ellen az írók és az olvasók pozíciója külön gyorsítótár-sorban van.
+	static constexpr size_t CACHE_LINE = 64;
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask;
+	alignas(CACHE_LINE) std::atomic<size_t> head{0};
+	alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+
+	/// A várakozók száma, ha 0, az írás és az olvasás nem zárol.
+	alignas(CACHE_LINE) std::atomic<size_t> waiting{0};
+	std::mutex lock;
+	std::condition_variable changed;
+
+	bool try_send(Object* o);
+	bool try_receive(Object*& o);
+	/// A várakozók felébresztése egy írás vagy olvasás után.
+	void wake(void);
+public:
+	/// A legnagyobb kapacitás; a puffer előre lefoglalt, így ez 16 MiB.
+	static constexpr size_t MAX_CAPACITY = (size_t)1 << 20;
+
+	/// @param capacity Legfeljebb ennyi elemet tárol, kettő hatványára (legalább 2-re) kerekítve,
+	/// 			legfeljebb \c MAX_CAPACITY.
+	explicit Channel(size_t capacity);
+	Channel(Channel const&) = delete;
+	Channel& operator=(Channel const&) = delete;
+
+	/// Objektum küldése, tele csatorna esetén várakozik.
+	/**
+	 * @param o Az objektum, siker esetén a csatorna (majd a fogadó) birtokolja.
+	 * 			Előtte fagyasztani kell, lásd Object::freeze().
+	 * @param deadline Ha meg van adva, ekkor \c TIMEOUT hibával feladja a várakozást.
+	 */
+	Error send(Object* o, Deadline const& deadline);
+
+	/// Objektum fogadása, üres csatorna esetén várakozik.
+	/// @param[out] o A legrégebben küldött objektum, amelyet a hívó birtokol.
+	/// @param deadline Mint send().
+	Error receive(Object*& o, Deadline const& deadline);
+
+	~Channel(void);
+};
+
+/// Függvény futtatása a szálkészlet egy szálán.
+/**
+ * Ha nincs szabad szál, és kevesebb szál fut, mint ahány processzor van, újat
+ * indít, különben a függvény sorban vár.
+ * @param job A futtatandó függvény.
+ * @returns \c OUT_OF_MEMORY, ha szálat nem sikerült indítani, és egyik futó szál
+ * 			sem veheti fel később a függvényt (ekkor nem fut le).
+ */
+Error start_task(std::function<void()> job);
+
+/// Fut-e még (vagy vár-e indulásra) valamelyik start_task() -kal indított függvény.
+bool tasks_running(void);
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @brief Szöveges keresés implementáció.
+ */
+#include <cstdint>
+#include <cstring>
+
+#include "text.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEXT_X86
+#endif
+
+/// Keresés hordozható módon (glibc-ben kétirányú, "two-way" algoritmus).
+static size_t find_generic(const char* s, size_t n, const char* p, size_t k) {
+	const void* r = memmem(s, n, p, k);
+	return r ? (const char*)r - s : std::string_view::npos;
+}
+
+#ifdef TEXT_X86
+__attribute__((target("avx2")))
+static size_t find_avx2(const char* s, size_t n, const char* p, size_t k) {
+	const __m256i first = _mm256_set1_epi8(p[0]);
+	const __m256i last = _mm256_set1_epi8(p[k - 1]);
+	size_t i = 0;
+	for (; i + k - 1 + 32 <= n; i += 32) {
+		__m256i f = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i l = _mm256_loadu_si256((const __m256i*)(s + i + k - 1));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(f, first), _mm256_cmpeq_epi8(l, last)));
+		while (mask) {
+			unsigned bit = __builtin_ctz(mask);
+			// the first and last bytes already match
+			if (memcmp(s + i + bit + 1, p + 1, k - 2) == 0) return i + bit;
+			mask &= mask - 1;
+		}
+	}
+	size_t rest = find_generic(s + i, n - i, p, k);
+	return rest == std::string_view::npos ? rest : i + rest;
+}
+#endif
+
+/// Hosszabb minták keresője, a processzor alapján kiválasztva.
+static size_t (*select_find(void))(const char*, size_t, const char*, size_t) {
+#ifdef TEXT_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return find_avx2;
+#endif
+	return find_generic;
+}
+
+size_t find_text(std::string_view text, std::string_view pattern, size_t from) {
+	if (from > text.size() || pattern.size() > text.size() - from) return std::string_view::npos;
+	if (pattern.empty()) return from;
+	const char* s = text.data() + from;
+	size_t n = text.size() - from;
+	size_t r;
+	if (pattern.size() == 1) {
+		const void* c = memchr(s, pattern[0], n);
+		r = c ? (const char*)c - s : std::string_view::npos;
+	} else {
+		static size_t (*const find)(const char*, size_t, const char*, size_t) = select_find();
+		r = find(s, n, pattern.data(), pattern.size());
+	}
+	return r == std::string_view::npos ? r : from + r;
+}
+
+// branch-free per byte, so the compiler vectorises the loops
+void to_upper(std::string& s) {
+	for (char& c: s) c ^= (char)(((unsigned char)(c - 'a') < 26) << 5);
+}
+
+void to_lower(std::string& s) {
+	for (char& c: s) c ^= (char)(((unsigned char)(c - 'A') < 26) << 5);
+}
@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief Keresés és átalakítás szövegekben.
+ */
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// Részszöveg első előfordulásának keresése.
+/**
+ * Egy bájtos mintát \c memchr -rel keres, hosszabbat AVX2-vel (ha a processzor
+ * támogatja): 32 pozícióra egyszerre hasonlítja a minta első és utolsó bájtját,
+ * és csak az egyező pozíciókon hasonlítja össze a teljes mintát.
+ * @param text A szöveg, amiben keres.
+ * @param pattern A keresett részszöveg (az üres szöveg a \c from pozíción található).
+ * @param from Innen kezdve keres.
+ * @returns Az előfordulás kezdete, vagy \c std::string_view::npos.
+ */
+size_t find_text(std::string_view text, std::string_view pattern, size_t from = 0);
+
+/// ASCII betűk nagybetűssé alakítása helyben.
+void to_upper(std::string& s);
+
+/// ASCII betűk kisbetűssé alakítása helyben.
+void to_lower(std::string& s);
+
+#endif
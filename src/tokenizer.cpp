@@ -9,84 +9,194 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdint>
+#include <string_view>
+#include <thread>
 
 #include "tokenizer.h"
+#include "scan.h"
 
 #define ERROR "[\x1b[91mERROR\x1b[m] "
 
-std::optional<std::vector<Token*>> tokenize(std::istream& stream) {
+/// Szóközökkel határolt szó tokenné alakítása (szám vagy szó).
+static Token* word_token(std::string const& word) {
+	// stoll throws unless a digit follows the optional sign, skip the exception in the common case
+	size_t digit = word[0] == '+' || word[0] == '-' ? 1 : 0;
+	if (digit >= word.size() || !isdigit((unsigned char)word[digit]))
+		return new TTWord(word);
+
+	// try to parse `word` as an int or a double
+	// using built-in functions really helps with the parsing (e.g. scientific notation, `0x` notation etc.)
+	// basically, all c-style numbers are supported
+	size_t read_int, read_dbl;
+	try {
+		int64_t n = stoll(word, &read_int, 0); double d = stod(word, &read_dbl);
+		if (read_int == word.size())
+			return new TTInt(n);
+		else if (read_dbl == word.size())
+			return new TTFloat(d);
+		else 
+			return new TTWord(word);
+	// stoll and stod throw if no characters can be parsed -> `word` is a word literal
+	/// @todo Máshogy megoldani? Exception-ök szinte úgy fájnak, mint Trianon
+	} catch(std::invalid_argument const&) {
+		return new TTWord(word);
+	}
+}
+
+std::optional<std::vector<Token*>> tokenize(std::string_view source, const char* file, uint32_t first_line) {
 	std::vector<Token*> tokens;
+	StructuralIndex index(source.data(), source.size());
 
-	// while the stream is not empty
-	while (stream.peek() != EOF) {	
-
-		// skip whitespace
-		while ( isspace(stream.peek()) ) (void)stream.get();
-		if (stream.peek() == EOF) break;
-
-		// handle strings
-		/// @todo handle escape strings
-		if (stream.peek() == '"') {
-			
-			// discard introducing `"`
-			(void)stream.get();
-			std::string acc;
-			
-			// get characters until next `"`
-			while (stream.peek() != '"') {
-
-				// this is an error
-				if (stream.peek() == EOF) {
-					std::cout << ERROR "Unterminated string literal";
-					return std::nullopt;
-				}
-
-				// save characters
-				acc.push_back(stream.get());
+	// newlines are counted lazily, up to the start of each token
+	uint32_t line = first_line;
+	size_t counted = 0;
+	auto locate = [&](Token* t, size_t at) {
+		line += (uint32_t)std::count(source.begin() + counted, source.begin() + at, '\n');
+		counted = at;
+		t->location = SourceLocation{file, line};
+		return t;
+	};
+
+	size_t pos = 0;
+	while ((pos = index.find(StructuralIndex::Space, pos, false)) < source.size()) {
+		if (source[pos] == '"') {
+			size_t end = index.find(StructuralIndex::Quote, pos + 1);
+			if (end == source.size()) {
+				std::cout << ERROR "Unterminated string literal";
+				for (Token* t: tokens) delete t;
+				return std::nullopt;
 			}
+			tokens.push_back(locate(new TTString(std::string(source.substr(pos + 1, end - pos - 1))), pos));
+			pos = end + 1;
+			continue;
+		}
+
+		size_t end = index.find(StructuralIndex::Space, pos);
+		if (end - pos == 1 && source[pos] == '!') {
+			// comments last until the newline, which is whitespace anyway
+			pos = index.find(StructuralIndex::Newline, end);
+			continue;
+		}
+		tokens.push_back(locate(word_token(std::string(source.substr(pos, end - pos))), pos));
+		pos = end;
+	}
+	return std::optional<std::vector<Token*>>(tokens);
+}
+
+bool ends_in_string(std::string_view source) {
+	StructuralIndex index(source.data(), source.size());
+	// the same boundaries as in tokenize(), without making tokens
+	size_t pos = 0;
+	while ((pos = index.find(StructuralIndex::Space, pos, false)) < source.size()) {
+		if (source[pos] == '"') {
+			size_t end = index.find(StructuralIndex::Quote, pos + 1);
+			if (end == source.size()) return true;
+			pos = end + 1;
+			continue;
+		}
+		size_t end = index.find(StructuralIndex::Space, pos);
+		pos = end - pos == 1 && source[pos] == '!' ? index.find(StructuralIndex::Newline, end) : end;
+	}
+	return false;
+}
+
+std::optional<std::vector<Token*>> tokenize(std::istream& stream, const char* file) {
+	std::string source;
+	char buffer[1 << 16];
+	while (stream.read(buffer, sizeof buffer) || stream.gcount() > 0)
+		source.append(buffer, stream.gcount());
+	return tokenize(std::string_view(source), file);
+}
+
+/// Ennél kisebb darabokra nem érdemes szálat indítani.
+static constexpr size_t MIN_CHUNK = 1 << 20;
+
+/// Vágási pontok keresése a forrásban.
+/**
+ * A darabok sorvége után kezdődnek, szövegen és kommenten kívül, így
+ * mindegyik külön tokenizálható. Csak a \c " és \c ! bájtoknál kell
+ * megnézni, hogy szöveg vagy komment kezdődik-e ott, a köztük lévő
+ * részekben bármelyik sorvégénél lehet vágni.
+ * @param parts Ennyi (legfeljebb) közel egyforma darabra vág.
+ * @returns A darabok kezdetei, és a végén a forrás mérete.
+ */
+static std::vector<size_t> split_points(std::string_view source, size_t parts) {
+	size_t n = source.size();
+	StructuralIndex index(source.data(), n);
+	std::vector<size_t> splits{0};
+	auto target = [&](void) { return n * splits.size() / parts; };
+
+	// `glued`: a token may start here without whitespace before it (right after a string)
+	size_t pos = 0, glued = 0;
+	size_t quote = index.find(StructuralIndex::Quote, 0), bang = index.find(StructuralIndex::Bang, 0);
+	while (splits.size() < parts) {
+		if (quote < pos) quote = index.find(StructuralIndex::Quote, pos);
+		if (bang < pos) bang = index.find(StructuralIndex::Bang, pos);
+		size_t next = std::min(quote, bang);
 
-			// discard the final `"`
-			(void)stream.get();
+		// everything before `next` is plain words and whitespace
+		while (splits.size() < parts && target() < next) {
+			size_t nl = index.find(StructuralIndex::Newline, std::max(target(), pos));
+			if (nl >= next) break;
+			splits.push_back(nl + 1);
+			pos = glued = nl + 1;
+		}
+		if (next == n) break;
 
-			// save as a string literal
-			tokens.push_back(new TTString(acc));
+		if (next != glued && !isspace((unsigned char)source[next - 1])) {
+			// inside a word
+			pos = next + 1;
+		} else if (source[next] == '"') {
+			size_t end = index.find(StructuralIndex::Quote, next + 1);
+			// unterminated, the last chunk reports it
+			if (end == n) break;
+			pos = glued = end + 1;
+		} else if (next + 1 == n || isspace((unsigned char)source[next + 1])) {
+			pos = index.find(StructuralIndex::Newline, next + 1);
 		} else {
-			// get a whitespace-delimited word
-			std::string word;
-			stream >> word;
-
-			// discard comments
-			if (word == "!") {
-				// skip all characters until newline
-				while (stream.peek() != '\n') {
-					if (stream.peek() == EOF)
-						// if at the end of the stream, just return all the tokens
-						return std::optional<std::vector<Token*>>(tokens);
-					(void)stream.get();
-				}
-			// otherwise 
-			} else {
-				// try to parse `word` as an int or a double
-				// using built-in functions really helps with the parsing (e.g. scientific notation, `0x` notation etc.)
-				// basically, all c-style numbers are supported
-				size_t read_int, read_dbl;
-				try {
-					int64_t n = stoll(word, &read_int, 0); double d = stod(word, &read_dbl);
-					if (read_int == word.size())
-						tokens.push_back(new TTInt(n));
-					else if (read_dbl == word.size())
-						tokens.push_back(new TTFloat(d));
-					else 
-						tokens.push_back(new TTWord(word));
-				// stoll and stod throw if no characters can be parsed -> `word` is a word literal
-				/// @todo Máshogy megoldani? Exception-ök szinte úgy fájnak, mint Trianon
-				} catch(std::invalid_argument const&) {
-					tokens.push_back(new TTWord(word));
-				}
-			}
+			pos = next + 1;
 		}
 	}
-	return std::optional<std::vector<Token*>>(tokens);
+	splits.push_back(n);
+	return splits;
+}
+
+std::optional<std::vector<Token*>> tokenize_parallel(std::string_view source, unsigned threads, const char* file) {
+	size_t parts = std::min<size_t>(threads, source.size() / MIN_CHUNK);
+	if (parts < 2) return tokenize(source, file);
+
+	std::vector<size_t> splits = split_points(source, parts);
+	std::vector<std::optional<std::vector<Token*>>> chunks(splits.size() - 1);
+	// the chunks count lines from 1, they are shifted by the newlines before them
+	std::vector<uint32_t> newlines(chunks.size());
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < chunks.size(); i++)
+		workers.emplace_back([&, i](void) {
+			std::string_view chunk = source.substr(splits[i], splits[i + 1] - splits[i]);
+			chunks[i] = tokenize(chunk, file);
+			newlines[i] = (uint32_t)std::count(chunk.begin(), chunk.end(), '\n');
+		});
+	for (std::thread& w: workers) w.join();
+
+	bool failed = false;
+	size_t count = 0;
+	for (auto const& c: chunks) {
+		if (c) count += c->size();
+		else failed = true;
+	}
+	std::vector<Token*> tokens;
+	tokens.reserve(failed ? 0 : count);
+	uint32_t offset = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		auto& c = chunks[i];
+		if (c && failed) for (Token* t: *c) delete t;
+		if (!c || failed) continue;
+		for (Token* t: *c) t->location.line += offset;
+		tokens.insert(tokens.end(), c->begin(), c->end());
+		offset += newlines[i];
+	}
+	if (failed) return std::nullopt;
+	return std::optional<std::vector<Token*>>(std::move(tokens));
 }
 
 void put_value(std::ostream& stream, Token const& t) {
@@ -8,13 +8,26 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <vector>
 #include <istream>
 
+/// Hely a forrásban.
+struct SourceLocation {
+	/// A forrásfájl neve, vagy \c nullptr, ha nem fájlból jött.
+	/// @warning Nem másolja, a program futása alatt érvényesnek kell maradnia.
+	const char* file = nullptr;
+	/// A sor sorszáma, 1-től számozva (0, ha ismeretlen).
+	uint32_t line = 0;
+};
+
 /// Karaktercsoportok extra jelentéssel.
 class Token {
 public:
+	/// A token helye a forrásban.
+	SourceLocation location;
+
 	/// A várható típusok.
 	enum Type {
 		/// Egész literál.
@@ -124,11 +137,46 @@ public:
 
 /// Stream tokenizálasa.
 /**
+ * A streamet végigolvassa, és a tokenize(std::string_view) -val tokenizálja.
  * @param stream A bemeneti stream, ahonnan a forrást olvassuk.
+ * @param file A forrásfájl neve a tokenek helyéhez (SourceLocation).
  * @returns Siker esetén a tokenek listáját. A tárolt tokeneket a hívó birtokolja. 
  * 			Hiba esetén  \code{.cpp} std::nullopt \endcode.
  */
-std::optional<std::vector<Token*>> tokenize(std::istream& stream);
+std::optional<std::vector<Token*>> tokenize(std::istream& stream, const char* file = nullptr);
+
+/// Memóriában lévő forrás tokenizálása.
+/**
+ * A határokat (szóközök, \c " és sorvégek) egy StructuralIndex -ből keresi,
+ * nem bájtonként.
+ * @param source A forrás.
+ * @param file A forrásfájl neve a tokenek helyéhez (SourceLocation).
+ * @param first_line A forrás első sorának sorszáma.
+ * @returns Siker esetén a tokenek listáját. A tárolt tokeneket a hívó birtokolja.
+ * 			Hiba esetén  \code{.cpp} std::nullopt \endcode.
+ */
+std::optional<std::vector<Token*>> tokenize(std::string_view source, const char* file = nullptr, uint32_t first_line = 1);
+
+/// Lezáratlan szöveg literálra végződik-e a forrás.
+/**
+ * Ugyanazokat a határokat keresi, mint tokenize(), de tokeneket nem készít
+ * és hibát sem ír ki. Az interaktív mód ezzel dönti el, hogy a sor
+ * folytatódik-e (a szöveg literálokban lehet sorvége).
+ * @param source A forrás.
+ */
+bool ends_in_string(std::string_view source);
+
+/// Memóriában lévő forrás tokenizálása több szálon.
+/**
+ * A forrást sorvégeknél, szövegeken és kommenteken kívül darabokra vágja, a
+ * darabokat párhuzamosan tokenizálja, majd a tokenlistákat összefűzi. Az
+ * eredmény ugyanaz, mint tokenize() -é.
+ * @param source A forrás.
+ * @param threads Legfeljebb ennyi szálat használ. Kis forrásra nem indít szálat.
+ * @param file A forrásfájl neve a tokenek helyéhez (SourceLocation).
+ * @returns Mint tokenize().
+ */
+std::optional<std::vector<Token*>> tokenize_parallel(std::string_view source, unsigned threads, const char* file = nullptr);
 
 /// @deprecated Valószínűleg többet nem fogom használni, a végső beadás előtt
 /// 			valószínűleg kikerül a codebase-ből.
@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @brief Nyomkövetés implementáció.
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+#include "trace.h"
+
+volatile std::sig_atomic_t Tracer::dump_requested = 0;
+
+static constexpr char TRACE_MAGIC[8] = {'S', 'T', 'A', 'C', 'C', 'T', 'R', '1'};
+
+Tracer::Tracer(size_t capacity, std::string output)
+	: ring(capacity ? capacity : 1), path(std::move(output)) {
+	start_ticks = last = ticks();
+	start_time = std::chrono::steady_clock::now();
+}
+
+bool Tracer::dump(void) const {
+	TraceHeader header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof header.magic);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+#ifdef TRACE_TSC
+	header.ticks_per_second = seconds > 0 ? (double)(ticks() - start_ticks) / seconds : 1e9;
+#else
+	(void)seconds;
+	header.ticks_per_second = 1e9;
+#endif
+	header.symbol_count = (uint32_t)symbols.size();
+	header.reserved = 0;
+	header.event_count = recorded < ring.size() ? recorded : ring.size();
+	header.recorded = recorded;
+
+	std::ofstream f(path, std::ios::binary | std::ios::trunc);
+	f.write((const char*)&header, sizeof header);
+	for (uint32_t i = 0; i < symbols.size(); i++) {
+		std::string const& s = symbols.name(i);
+		uint32_t length = (uint32_t)s.size();
+		f.write((const char*)&length, sizeof length);
+		f.write(s.data(), s.size());
+	}
+	// oldest first: after wrapping around, the oldest event is at the head
+	if (recorded > ring.size())
+		f.write((const char*)(ring.data() + head), (ring.size() - head) * sizeof(TraceEvent));
+	f.write((const char*)ring.data(), head * sizeof(TraceEvent));
+	return f.good();
+}
+
+void Tracer::on_signal(int) {
+	dump_requested = 1;
+}
+
+void Tracer::dump_on_signal(void) {
+	struct sigaction action;
+	memset(&action, 0, sizeof action);
+	action.sa_handler = on_signal;
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &action, nullptr);
+}
+
+/// Szöveg kiírása JSON szövegként.
+static void json_string(std::ostream& out, std::string const& s) {
+	out << '"';
+	for (unsigned char c: s) {
+		if (c == '"' || c == '\\') out << '\\' << c;
+		else if (c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof buf, "\\u%04x", c);
+			out << buf;
+		} else out << c;
+	}
+	out << '"';
+}
+
+bool decode_trace(const char* path, std::ostream& out, bool chrome) {
+	std::ifstream f(path, std::ios::binary);
+	TraceHeader header;
+	if (!f.read((char*)&header, sizeof header) || memcmp(header.magic, TRACE_MAGIC, sizeof header.magic) != 0)
+		return false;
+
+	std::vector<std::string> symbols(header.symbol_count);
+	for (std::string& s: symbols) {
+		uint32_t length;
+		if (!f.read((char*)&length, sizeof length)) return false;
+		s.resize(length);
+		if (!f.read(s.data(), length)) return false;
+	}
+	std::vector<TraceEvent> events(header.event_count);
+	if (!f.read((char*)events.data(), events.size() * sizeof(TraceEvent))) return false;
+	for (TraceEvent const& e: events)
+		if (e.symbol >= symbols.size()) return false;
+
+	// microseconds since tracing started (since the first clock reading in a
+	// wrapped buffer); the clock is only read at some events, the ones between
+	// them are spread evenly
+	std::vector<double> times(events.size(), 0);
+	double us_per_tick = 1e6 / header.ticks_per_second, time = 0;
+	// the first reading in a wrapped buffer counts from an overwritten event
+	bool wrapped = header.recorded > header.event_count;
+	ptrdiff_t previous = -1;
+	for (size_t i = 0; i < events.size(); i++) {
+		if (events[i].delta == 0) continue;
+		if (wrapped && previous < 0) {
+			previous = (ptrdiff_t)i;
+			continue;
+		}
+		double elapsed = events[i].delta * us_per_tick;
+		for (size_t j = previous + 1; j <= i; j++)
+			times[j] = time + elapsed * (double)(j - previous) / (double)(i - previous);
+		time += elapsed;
+		previous = (ptrdiff_t)i;
+	}
+	for (size_t j = previous + 1; j < events.size(); j++) times[j] = time;
+
+	out << std::fixed << std::setprecision(3);
+	if (chrome) {
+		out << "{\"traceEvents\":[";
+		for (size_t i = 0; i < events.size(); i++) {
+			// a word lasts until the next one starts
+			double duration = i + 1 < events.size() ? times[i + 1] - times[i] : 0;
+			out << (i ? ",\n" : "\n") << "{\"name\":";
+			json_string(out, symbols[events[i].symbol]);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << times[i]
+				<< ",\"dur\":" << duration << ",\"args\":{\"depth\":" << events[i].depth << "}}";
+		}
+		out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+	} else {
+		out << "# " << events.size() << " of " << header.recorded << " events, times interpolated between clock readings\n";
+		out << "#     time (us)   depth  word\n";
+		for (size_t i = 0; i < events.size(); i++)
+			out << std::setw(15) << times[i] << std::setw(8) << events[i].depth << "  " << symbols[events[i].symbol] << "\n";
+	}
+	return out.good();
+}
@@ -0,0 +1,134 @@
+/**
+ * @file
+ * @brief Futás nyomkövetése egy rögzített méretű gyűrűpufferbe.
+ *
+ * Minden futtatott szóról egy kis bináris eseményt ír (a szó azonosítója, a
+ * verem mérete és az előző esemény óta eltelt idő), a puffer megtelte után a
+ * legrégebbieket felülírva. A puffer tartalmát fájlba lehet menteni, és a
+ * decode_trace() alakítja olvasható szöveggé vagy Chrome trace JSON-ná.
+ *
+ * A fájl formátuma (a gép bájtsorrendjével): egy TraceHeader, utána
+ * \c symbol_count darab szó neve (32 bites hossz, majd a bájtok), végül
+ * \c event_count darab TraceEvent, a legrégebbitől kezdve.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "symbols.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_TSC
+#endif
+
+/// Egy futtatott szó.
+struct TraceEvent {
+	/// A szó azonosítója, a fájl szavainak indexe.
+	uint32_t symbol;
+	/// A verem mérete a szó futtatása előtt.
+	uint32_t depth;
+	/// Az előző időbélyeges esemény óta eltelt idő, órajelben (lásd TraceHeader::ticks_per_second),
+	/// vagy 0, ha az eseménynél nem volt időmérés (lásd Tracer).
+	uint64_t delta;
+};
+
+/// A nyomkövetési fájl fejléce.
+struct TraceHeader {
+	char magic[8];
+	/// Az időmérő frekvenciája.
+	double ticks_per_second;
+	/// A fájlban lévő szavak száma.
+	uint32_t symbol_count;
+	uint32_t reserved;
+	/// A fájlban lévő események száma.
+	uint64_t event_count;
+	/// Az összes rögzített esemény száma (a felülírtakkal együtt).
+	uint64_t recorded;
+};
+
+/// Gyűrűpuffer a futtatott szavak eseményeinek.
+/**
+ * Az idő lekérdezése többe kerül, mint egy egyszerű beépített szó futtatása,
+ * ezért csak minden TIMESTAMP_INTERVAL -edik eseménynél kérdezi le; a többi
+ * esemény \c delta -ja 0, az eltelt idő a csoport utolsó eseményénél szerepel.
+ */
+class Tracer {
+	std::vector<TraceEvent> ring;
+	/// A következő esemény helye.
+	size_t head = 0;
+	uint64_t recorded = 0;
+	uint64_t last;
+	/// Az időmérő kezdőértéke a frekvencia kiszámolásához.
+	uint64_t start_ticks;
+	std::chrono::steady_clock::time_point start_time;
+	/// A mentés helye.
+	std::string path;
+
+	/// Ennyi eseményenként kérdezi le az időt.
+	static constexpr uint64_t TIMESTAMP_INTERVAL = 16;
+
+	/// Az időmérő aktuális értéke (x86-on a \c rdtsc, máshol nanoszekundum).
+	static uint64_t ticks(void) {
+#ifdef TRACE_TSC
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	static volatile std::sig_atomic_t dump_requested;
+	static void on_signal(int);
+public:
+	/// A rögzített szavak.
+	SymbolTable symbols;
+
+	/// @param capacity A puffer mérete (eseményekben), legalább 1.
+	/// @param output A mentés helye.
+	Tracer(size_t capacity, std::string output);
+
+	/// Egy szó futtatásának rögzítése.
+	/// @param symbol A szó azonosítója a \c symbols táblában.
+	/// @param depth A verem mérete.
+	void record(uint32_t symbol, size_t depth) {
+		TraceEvent& e = ring[head];
+		e.symbol = symbol;
+		e.depth = (uint32_t)depth;
+		e.delta = 0;
+		if (++head == ring.size()) head = 0;
+		if (++recorded % TIMESTAMP_INTERVAL == 0) {
+			uint64_t now = ticks();
+			e.delta = now - last;
+			last = now;
+			if (dump_requested) {
+				dump_requested = 0;
+				dump();
+			}
+		}
+	}
+
+	/// A puffer mentése, a korábbi mentést felülírva.
+	/// @returns Sikerült-e a fájlt kiírni.
+	bool dump(void) const;
+
+	/// A puffer mentése \c SIGUSR1 -re (a következő időbélyeges eseménynél).
+	static void dump_on_signal(void);
+};
+
+/// Nyomkövetési fájl kiírása.
+/**
+ * @param path A fájl elérési útja.
+ * @param out Ide ír.
+ * @param chrome Chrome trace JSON-t ír (\c chrome://tracing, Perfetto), különben soronként egy eseményt.
+ * @returns Hamis, ha a fájl nem olvasható vagy hibás.
+ */
+bool decode_trace(const char* path, std::ostream& out, bool chrome);
+
+#endif
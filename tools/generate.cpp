@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief Szintetikus program kiírása a standard kimenetre.
+ *
+ * Használat: <tt>stacc-gen [--statements=N] [--depth=D] [--strings=P]
+ * [--list-size=L] [--recursion=R] [--seed=S] > program.stc</tt>
+ */
+#include <iostream>
+
+#include "workload.h"
+
+#define ERROR "[\x1b[91mERROR\x1b[m] "
+
+int main(int argc, char** argv) {
+	Workload w;
+	for (int i = 1; i < argc; i++) {
+		bool valid;
+		if (!workload_option(argv[i], w, valid)) {
+			std::cerr << ERROR "Unknown option '" << argv[i] << "'\n";
+			return 1;
+		}
+		if (!valid) {
+			std::cerr << ERROR "Invalid value in option '" << argv[i] << "'\n";
+			return 1;
+		}
+	}
+	generate_workload(std::cout, w);
+	return 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file
+ * @brief A tokenizálás, az elemzés és a futtatás skálázódásának mérése.
+ *
+ * Használat: <tt>stacc-scaling [--from=N] [--to=N] [--factor=F] [--repeat=K]
+ * [--depth=D] [--strings=P] [--list-size=L] [--recursion=R] [--seed=S]</tt>
+ *
+ * Az utasítások számát \c --from -tól \c --to -ig \c --factor -onként növeli,
+ * és minden méretre generál egy programot (lásd workload.h). A tokenize(),
+ * parse() és interpret() idejét \c --repeat futás minimumaként méri, a
+ * memóriát a folyamat csúcs-RSS-eként az egyes fázisok után. Minden méret
+ * külön folyamatban fut, hogy a korábbi méretek memóriája ne számítson bele.
+ *
+ * A \c k oszlopok a fázis idejének növekedési kitevője a tokenek számához
+ * képest, az előző mérettől (1 körül lineáris); a szuperlineárisakat \c ! jelöli.
+ */
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "workload.h"
+#include "tokenizer.h"
+#include "parser.h"
+#include "interpreter.h"
+
+#define ERROR "[\x1b[91mERROR\x1b[m] "
+
+/// Ennél nagyobb növekedési kitevő szuperlineáris.
+static constexpr double SUPERLINEAR = 1.25;
+
+/// Egy méret mérésének eredménye.
+struct Measurement {
+	bool ok;
+	size_t bytes, tokens, objects;
+	/// A fázisok ideje másodpercben.
+	double tokenize, parse, interpret;
+	/// A csúcs-RSS kilobájtban az egyes fázisok után.
+	long rss_tokenize, rss_parse, rss_interpret;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long peak_rss(void) {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/// A program előállítása és a fázisok mérése (a hívó folyamatban).
+static Measurement measure(Workload const& w, size_t repeat) {
+	Measurement m;
+	memset(&m, 0, sizeof m);
+	m.tokenize = m.parse = m.interpret = std::numeric_limits<double>::infinity();
+
+	std::ostringstream source;
+	generate_workload(source, w);
+	std::string text = source.str();
+	m.bytes = text.size();
+
+	for (size_t r = 0; r < repeat; r++) {
+		auto start = std::chrono::steady_clock::now();
+		std::optional<std::vector<Token*>> tokens = tokenize(std::string_view(text), "workload");
+		m.tokenize = std::min(m.tokenize, seconds_since(start));
+		if (!tokens) return m;
+		if (r == 0) m.rss_tokenize = peak_rss();
+		m.tokens = tokens->size();
+
+		start = std::chrono::steady_clock::now();
+		std::vector<Token*>::const_iterator begin = tokens->cbegin();
+		std::optional<std::vector<Object*>> parsed = parse(begin, tokens->cend());
+		m.parse = std::min(m.parse, seconds_since(start));
+		if (!parsed) return m;
+		if (r == 0) m.rss_parse = peak_rss();
+		m.objects = parsed->size();
+
+		Stack stack;
+		Dictionary words;
+		std::ostream discard(nullptr);
+		Environment env{stack, words, discard};
+		start = std::chrono::steady_clock::now();
+		Error e = interpret(*parsed, env);
+		m.interpret = std::min(m.interpret, seconds_since(start));
+		if (e != SUCCESS) return m;
+		if (r == 0) m.rss_interpret = peak_rss();
+
+		for (Object* o: stack) delete o;
+		for (Object* o: *parsed) delete o;
+		for (Token* t: *tokens) delete t;
+	}
+	m.ok = true;
+	return m;
+}
+
+/// Mérés egy külön folyamatban.
+/// @returns Hamis, ha a folyamat nem adott eredményt (pl. összeomlott).
+static bool measure_isolated(Workload const& w, size_t repeat, Measurement& m) {
+	int fds[2];
+	if (pipe(fds) != 0) return false;
+	pid_t child = fork();
+	if (child < 0) return false;
+	if (child == 0) {
+		close(fds[0]);
+		Measurement result = measure(w, repeat);
+		ssize_t written = write(fds[1], &result, sizeof result);
+		_exit(written == sizeof result ? 0 : 1);
+	}
+	close(fds[1]);
+	ssize_t got = read(fds[0], &m, sizeof m);
+	close(fds[0]);
+	int status;
+	waitpid(child, &status, 0);
+	return got == sizeof m;
+}
+
+/// Növekedési kitevő oszlop: <tt>log(t / t0) / log(n / n0)</tt>.
+static std::string exponent(double t, double t0, double n, double n0) {
+	if (n0 <= 0 || t0 <= 0 || t <= 0) return "";
+	double k = std::log(t / t0) / std::log(n / n0);
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(2) << k << (k > SUPERLINEAR ? "!" : "");
+	return s.str();
+}
+
+/// Számértékű kapcsoló (pl. \c --from=1000) értékének beolvasása.
+/// @returns Hamis, ha az érték nem pozitív egész.
+static bool numeric_option(const char* arg, size_t& out) {
+	const char* n = strchr(arg, '=') + 1;
+	char* end;
+	out = strtoull(n, &end, 10);
+	return *n != '\0' && *end == '\0' && *n != '-' && out > 0;
+}
+
+int main(int argc, char** argv) {
+	Workload w;
+	size_t from = 1000, to = 256000, factor = 2, repeat = 3;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool valid = true;
+		if (arg.rfind("--from=", 0) == 0) valid = numeric_option(argv[i], from);
+		else if (arg.rfind("--to=", 0) == 0) valid = numeric_option(argv[i], to);
+		else if (arg.rfind("--factor=", 0) == 0) valid = numeric_option(argv[i], factor) && factor > 1;
+		else if (arg.rfind("--repeat=", 0) == 0) valid = numeric_option(argv[i], repeat);
+		else if (!workload_option(argv[i], w, valid)) {
+			std::cerr << ERROR "Unknown option '" << arg << "'\n";
+			return 1;
+		}
+		if (!valid) {
+			std::cerr << ERROR "Invalid value in option '" << arg << "'\n";
+			return 1;
+		}
+	}
+
+	std::cout << "depth=" << w.depth << " strings=" << w.string_percent << "% list-size=" << w.list_size
+		<< " recursion=" << w.recursion << " seed=" << w.seed << " repeat=" << repeat << "\n";
+	std::cout << std::setw(10) << "statements" << std::setw(11) << "bytes" << std::setw(10) << "tokens"
+		<< std::setw(13) << "tokenize ms" << std::setw(7) << "k"
+		<< std::setw(10) << "parse ms" << std::setw(7) << "k"
+		<< std::setw(14) << "interpret ms" << std::setw(7) << "k"
+		<< std::setw(28) << "peak MB tokenize/parse/run" << "\n";
+
+	Measurement previous{};
+	size_t previous_n = 0;
+	bool superlinear = false;
+	for (size_t n = from; n <= to; n = n > to / factor ? to + 1 : n * factor) {
+		w.statements = n;
+		Measurement m{};
+		if (!measure_isolated(w, repeat, m) || !m.ok) {
+			std::cout << std::setw(10) << n << "  failed\n";
+			previous_n = 0;
+			continue;
+		}
+		std::string k_tokenize = previous_n ? exponent(m.tokenize, previous.tokenize, m.tokens, previous.tokens) : "";
+		std::string k_parse = previous_n ? exponent(m.parse, previous.parse, m.tokens, previous.tokens) : "";
+		std::string k_interpret = previous_n ? exponent(m.interpret, previous.interpret, m.tokens, previous.tokens) : "";
+		for (std::string const* k: {&k_tokenize, &k_parse, &k_interpret})
+			if (!k->empty() && k->back() == '!') superlinear = true;
+
+		std::ostringstream memory;
+		memory << std::fixed << std::setprecision(1) << m.rss_tokenize / 1024.0 << "/"
+			<< m.rss_parse / 1024.0 << "/" << m.rss_interpret / 1024.0;
+		std::cout << std::fixed << std::setprecision(2)
+			<< std::setw(10) << n << std::setw(11) << m.bytes << std::setw(10) << m.tokens
+			<< std::setw(13) << m.tokenize * 1000 << std::setw(7) << k_tokenize
+			<< std::setw(10) << m.parse * 1000 << std::setw(7) << k_parse
+			<< std::setw(14) << m.interpret * 1000 << std::setw(7) << k_interpret
+			<< std::setw(28) << memory.str() << "\n";
+		previous = m;
+		previous_n = n;
+	}
+	if (superlinear) std::cout << "! marks super-linear growth (exponent above " << SUPERLINEAR << ")\n";
+	return 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @brief Szintetikus programok előállításának implementációja.
+ */
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "workload.h"
+
+/// A szöveg literálok szavai.
+static const char* const TEXT_WORDS[] = {"stack", "word", "block", "list", "token", "parse", "seaman", "hello"};
+static constexpr size_t TEXT_WORD_COUNT = sizeof(TEXT_WORDS) / sizeof(TEXT_WORDS[0]);
+
+/// Az utasítások fajtái (a szövegeseken kívül).
+enum Statement {
+	ARITHMETIC,
+	NESTED_BLOCKS,
+	NESTED_LIST,
+	MAP_REDUCE,
+	RECURSION,
+	DEFINITION,
+	CALL,
+	STATEMENT_COUNT,
+};
+
+/// A generálás állapota.
+struct Generator {
+	std::ostream& out;
+	Workload const& w;
+	std::mt19937_64 rng;
+	/// Az eddig definiált \c wN szavak száma.
+	size_t definitions = 0;
+
+	Generator(std::ostream& out, Workload const& w): out(out), w(w), rng(w.seed) {}
+
+	/// Álvéletlen szám a <tt>[0, n)</tt> intervallumból (a std eloszlásai platformfüggők).
+	uint64_t pick(uint64_t n) { return rng() % n; }
+
+	/// Egymásba ágyazott blokkok, a legbelső egy kis számítás; mindegyik le is fut.
+	void blocks(size_t depth) {
+		if (depth == 0) {
+			out << pick(100) << " " << pick(100) << " + drop";
+			return;
+		}
+		out << "1 [ ";
+		blocks(depth - 1);
+		out << " ] [ ] if";
+	}
+
+	/// Lista literál: az első eleme eggyel kisebb mélységű lista, a többi egész.
+	void list(size_t depth) {
+		out << "{";
+		size_t items = w.list_size;
+		if (depth > 1 && items > 0) {
+			out << " ";
+			list(depth - 1);
+			items--;
+		}
+		for (size_t i = 0; i < items; i++) out << " " << pick(1000);
+		out << " }";
+	}
+
+	/// Szöveg literál néhány szóból, néha escape-szekvenciával.
+	void text(void) {
+		out << "\"";
+		size_t words = 1 + pick(6);
+		for (size_t i = 0; i < words; i++) {
+			if (i) out << (pick(8) == 0 ? "\\n" : " ");
+			out << TEXT_WORDS[pick(TEXT_WORD_COUNT)];
+		}
+		out << "\"";
+	}
+
+	void statement(void) {
+		if (pick(100) < w.string_percent) {
+			text();
+			if (pick(2)) {
+				out << " ";
+				text();
+				out << " +";
+			}
+			out << " length drop\n";
+			return;
+		}
+		switch (pick(STATEMENT_COUNT)) {
+			case ARITHMETIC:
+				out << pick(1000) << " " << pick(1000) << " + " << 1 + pick(9) << " * mix drop\n";
+				break;
+			case NESTED_BLOCKS:
+				blocks(w.depth);
+				out << "\n";
+				break;
+			case NESTED_LIST:
+				list(w.depth);
+				out << " length drop\n";
+				break;
+			case MAP_REDUCE:
+				if (w.list_size == 0) {
+					out << "{ } length drop\n";
+					break;
+				}
+				out << "{";
+				for (size_t i = 0; i < w.list_size; i++) out << " " << pick(1000);
+				out << " } [ inc ] map [ + ] reduce1 drop\n";
+				break;
+			case RECURSION:
+				out << w.recursion << " down drop\n";
+				break;
+			case DEFINITION:
+				out << "[ " << pick(100) << " + mix ] 'w" << definitions << " " << pick(100) << " w" << definitions << " drop\n";
+				definitions++;
+				break;
+			case CALL:
+				if (definitions == 0) out << pick(100) << " mix drop\n";
+				else out << pick(100) << " w" << pick(definitions) << " drop\n";
+				break;
+		}
+	}
+};
+
+bool workload_option(const char* arg, Workload& w, bool& valid) {
+	static const char* const NAMES[] = {"--statements=", "--depth=", "--strings=", "--list-size=", "--recursion=", "--seed="};
+	constexpr size_t COUNT = sizeof(NAMES) / sizeof(NAMES[0]);
+	size_t option = 0;
+	while (option < COUNT && strncmp(arg, NAMES[option], strlen(NAMES[option])) != 0) option++;
+	if (option == COUNT) return false;
+
+	const char* n = arg + strlen(NAMES[option]);
+	char* end;
+	unsigned long long value = strtoull(n, &end, 10);
+	valid = *n != '\0' && *end == '\0' && *n != '-';
+	switch (option) {
+		case 0: w.statements = value; break;
+		case 1: w.depth = value; break;
+		case 2: valid = valid && value <= 100; w.string_percent = (unsigned)value; break;
+		case 3: w.list_size = value; break;
+		case 4: w.recursion = value; break;
+		case 5: w.seed = value; break;
+	}
+	return true;
+}
+
+void generate_workload(std::ostream& out, Workload const& w) {
+	out << "! generated: statements=" << w.statements << " depth=" << w.depth
+		<< " strings=" << w.string_percent << "% list-size=" << w.list_size
+		<< " recursion=" << w.recursion << " seed=" << w.seed << "\n";
+	out << "[ dup 0 > [ dec down ] [ ] if ] 'down\n";
+	out << "[ dup * 1 + 7 % ] 'mix\n";
+	Generator g(out, w);
+	for (size_t i = 0; i < w.statements; i++) g.statement();
+}
@@ -0,0 +1,51 @@
+/**
+ * @file
+ * @brief Szintetikus, paraméterezhető stacc programok előállítása (méréshez).
+ *
+ * A program egy előtag (segédszavak definíciója) után soronként egy
+ * legfelső szintű utasításból áll. Minden utasítás üres veremmel indul és
+ * üres vermet hagy, így a program bármilyen méretben hibátlanul lefut, és a
+ * futás ideje az utasítások számával arányos. Az utasítások fajtáját egy
+ * rögzített \c seed -ű álvéletlen-generátor választja, így ugyanazokkal a
+ * paraméterekkel mindig ugyanaz a program készül.
+ */
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/// A generált program paraméterei.
+struct Workload {
+	/// A legfelső szintű utasítások száma.
+	size_t statements = 1000;
+	/// A blokkok (\c [ \c ]) és a listák (\c { \c }) egymásba ágyazásának mélysége.
+	size_t depth = 3;
+	/// A szöveges utasítások aránya százalékban.
+	unsigned string_percent = 20;
+	/// A lista literálok elemszáma.
+	size_t list_size = 8;
+	/// A rekurzív szó hívási mélysége.
+	size_t recursion = 32;
+	/// Az álvéletlen-generátor kezdőértéke.
+	uint64_t seed = 1;
+};
+
+/// A program egy paraméterének beolvasása parancssori kapcsolóból.
+/**
+ * Kapcsolók: \c --statements=N, \c --depth=D, \c --strings=P, \c --list-size=L,
+ * \c --recursion=R, \c --seed=S.
+ * @param arg A kapcsoló.
+ * @param[out] w Ebbe írja a paramétert.
+ * @param[out] valid Hamis, ha az érték nem nemnegatív egész (a százalék legfeljebb 100).
+ * @returns Ilyen kapcsoló-e.
+ */
+bool workload_option(const char* arg, Workload& w, bool& valid);
+
+/// Program kiírása.
+/// @param out Ide írja a forrást.
+/// @param w A program paraméterei.
+void generate_workload(std::ostream& out, Workload const& w);
+
+#endif